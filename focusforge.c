@@ -1,5 +1,7 @@
 // === focusforge.c ===
-// Build: gcc -std=c99 -Wall -Wextra -O2 focusforge.c -lncurses -o focusforge
+// Build: gcc -std=c99 -Wall -Wextra -O2 focusforge.c -lncurses -lpthread -o focusforge
+
+#define _GNU_SOURCE  // signalfd, timerfd, clock_gettime and pread under -std=c99
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,9 +9,28 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/inotify.h>
+#include <sys/file.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <limits.h>
 #include <signal.h>
+#include <sched.h>
 #include <ncurses.h>
 
 /* Define constants */
@@ -22,6 +43,7 @@
 #define MAX_INPUT_LEN 512    // Maximum length for user input
 #define MAX_PATH_LEN PATH_MAX
 #define FOCUSFORGE_VERSION "0.1.0"
+#define NS_PER_SEC 1000000000LL
 
 /* UI Constants */
 #define NOTIFICATION_HEIGHT 3
@@ -29,6 +51,82 @@
 #define HELP_WIDTH 35
 #define MIN_TERMINAL_HEIGHT 10
 #define MIN_TERMINAL_WIDTH 80
+#define TIMER_TEXT_LEN 32
+#define INPUT_PROMPT "Add task:"
+#define INPUT_HINT "Enter: add task | Space: set focus | ?: help"
+#define LOW_BANDWIDTH_REDRAW_NS 1000000000LL  // At most one full redraw per second
+#define LOW_BANDWIDTH_BAUD 9600  // Auto-enable low-bandwidth mode at or below this speed
+#define WAKEUP_SAMPLES 1024  // Enough to count a busy minute of wakeups exactly
+#define OVERLAY_HEIGHT 7
+#define OVERLAY_WIDTH 46
+#define MAX_VIEWS 4  // Modal views that can be stacked
+#define VIEW_TOP 7  // Views open below the timer box so the countdown stays visible
+#define HISTORY_WIDTH 60
+
+/* Frame instrumentation */
+#define FRAME_SAMPLES 256      // Rolling window used for the p50/p99 histogram
+#define LATENCY_SAMPLES 4096   // Keypress-to-paint samples kept for the exit dump
+
+/* Help panel sections */
+#define HELP_SECTION_SESSION 0
+#define HELP_SECTION_TASK 1
+#define HELP_SECTION_OTHER 2
+
+/* Timing wheel: 6 levels of 64 slots at 1 ms cover 2^36 ms (~2.2 years) */
+#define WHEEL_LEVELS 6
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+#define WHEEL_TICK_NS 1000000LL
+#define WHEEL_DUE (WHEEL_LEVELS + 1)  // Level of a timer on the list wheel_advance() is working through
+
+/* Suspend policies, set with suspend_policy= in the settings file */
+#define SUSPEND_PAUSE 0   // Timer stands still while the machine sleeps
+#define SUSPEND_COUNT 1   // Sleep counts as session time
+#define SUSPEND_END 2     // Session ends where the sleep began
+#define SUSPEND_MIN_GAP_NS 1000000000LL  // Smaller gaps are clock-read noise
+
+/* Crash checkpoint of the running session */
+#define CHECKPOINT_MAGIC "FFCKPT1"
+#define CHECKPOINT_INTERVAL_NS (5 * NS_PER_SEC)  // Most session time a crash can lose
+
+/* Event log: events.log is the record, snapshot.bin a shortcut into it */
+#define SNAPSHOT_MAGIC "FFSNAP2"
+#define SNAPSHOT_EVERY 500        // Events appended between snapshots
+#define STRESS_ROUNDS 400         // Batches each --stress instance writes
+#define STRESS_SESSION_EVERY 10   // Batches per logged session
+#define EVENT_BATCH_SIZE 65536    // Events buffered before a forced write
+#define PERSIST_RING_SIZE (1 << 20)  // Writes queued for the writer thread; a power of two
+
+/* Shared status page for status bars */
+#define STATUS_MAGIC "FFSTAT1"
+#define STATUS_READ_ATTEMPTS 10000  // Retries before a reader gives up on a stuck writer
+
+/* Daemon and its clients */
+#define MAX_CLIENTS 16
+#define DAEMON_BUF_SIZE 65536     // Holds a full state update with MAX_TASKS tasks
+
+/* Event feed for integrations */
+#define MAX_SUBSCRIBERS 16
+#define FEED_RING_SIZE 65536      // Per subscriber; a slower reader loses objects
+#define FEED_LINE_SIZE 4096       // Longest object: two escaped task texts
+
+/* Prometheus metrics */
+#define METRICS_BUCKETS 12        // Histogram bounds, plus +Inf
+#define METRICS_SIZE 8192         // Longest exposition, HTTP header included
+#define METRICS_FILE_INTERVAL_NS (15 * NS_PER_SEC)  // --metrics-file rewrite period
+#define MAX_SCRAPERS 8            // --metrics-port connections at once
+#define SCRAPE_REQUEST_SIZE 2048  // Longest request header accepted
+#define SCRAPE_IDLE_NS (5 * NS_PER_SEC)  // A request not complete by then is dropped
+
+/* Multi-user server */
+#define SHARD_BUCKETS 1024
+#define SHARD_NAME_LEN 33         // User names up to 32 characters
+#define SERVER_MAX_EVENTS 64
+#define SERVER_REPLY_SIZE 16384   // Replies a connection may have unsent
+#define BENCH_SERVER_USERS 300
+#define BENCH_SERVER_THREADS 8
+#define BENCH_SERVER_SECONDS 3
+#define BENCH_SERVER_SAMPLES 200000  // Latencies kept per load thread
 
 /* Session states */
 #define SESSION_INACTIVE 0
@@ -57,6 +155,265 @@ typedef struct {
     int streak_current;
 } StreakData;
 
+typedef struct {
+    char date[DATE_STR_LEN];      // YYYY-MM-DD
+    int sessions;
+    int focus_seconds;
+} DayStats;
+
+typedef struct {
+    int key;              // Key as typed; letters also match their upper case
+    int alt_key;          // Second key with the same action, 0 if none
+    const char *label;    // Key name shown in the help panel
+    const char *help;     // Help panel description
+    int section;          // HELP_SECTION_* heading the entry is listed under
+    void (*action)();
+} KeyBinding;
+
+struct Timer;
+typedef void (*TimerCallback)(struct Timer *timer, void *ctx);
+
+typedef struct Timer {
+    const char *name;           // For diagnostics; not required to be unique
+    long long expires;          // Due time in wheel ticks
+    TimerCallback callback;
+    void *ctx;
+    int level;                  // Wheel level, WHEEL_LEVELS on overflow, WHEEL_DUE, -1 when idle
+    int slot;
+    struct Timer *prev, *next;
+} Timer;
+
+typedef struct {
+    long long now;                            // Current tick; earlier ticks are done
+    Timer *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_LEVELS];          // Bit per non-empty slot
+    Timer *overflow;                          // Due after the top level's window
+    Timer *due;                               // Slot taken off the wheel by wheel_advance()
+    int count;                                // Pending timers
+} TimerWheel;
+
+typedef void (*EventHandler)(int fd, uint32_t events, void *ctx);
+
+typedef struct EventSource {
+    int fd;                     // -1 once removed; freed after the current dispatch
+    EventHandler handler;
+    void *ctx;
+    struct EventSource *next;
+} EventSource;
+
+typedef struct {
+    long long build_ns[FRAME_SAMPLES];    // Time spent preparing windows
+    long long update_ns[FRAME_SAMPLES];   // Time spent inside doupdate()
+    long bytes[FRAME_SAMPLES];            // Bytes sent to the terminal
+    int head;                             // Next ring slot to overwrite
+    int count;                            // Valid ring entries
+    long long frames;                     // Total frames committed
+    long long latency_ns[LATENCY_SAMPLES];
+    int latency_count;
+    long long key_pending_ns;             // Arrival time of the unpainted key
+} FrameStats;
+
+/* A modal view drawn over the main screen. The event loop keeps running
+ * while views are open; keys go to the top one. */
+typedef struct {
+    const char *title;
+    int (*draw)(WINDOW *win, int first, int rows);  // Draws lines first.. from row 1; returns the line count
+    int width;                    // Wanted width, clamped to the terminal
+    int scroll;                   // First line shown
+    int lines;                    // Line count from the last draw
+    WINDOW *win;
+} View;
+
+/* Every change to persistent state is one of these. state_emit() appends
+ * it to events.log and applies it; startup replays the log the same way. */
+typedef enum {
+    EV_TASK_ADD,        // text: task
+    EV_TASK_DONE,       // index: task
+    EV_TASK_UNDONE,     // index: task
+    EV_TASK_REMOVE,     // index: task
+    EV_TASK_EDIT,       // index: task, text: its new text
+    EV_TASK_INSERT,     // index: position of the new task, text: task
+    EV_FOCUS,           // text: new focus task
+    EV_SESSION_START,   // index: SESSION_FOCUS or SESSION_BREAK
+    EV_SESSION_STOP,
+    EV_SESSION_SKIP,
+    EV_SESSION_LOG,     // text: the sessions.csv row
+    EV_DAY_SEAL,        // text: the days.csv rollup row of a finished day
+    EV_IMPORT,          // text: "<streak max> <streak> <last session day> <day> <sessions> <seconds>",
+                        // taken over from files older than the log; "-" for an empty date
+    EV_COUNT
+} StateEventType;
+
+typedef struct {
+    long long seq;                // 1 for the first event ever written
+    long long at;                 // Wall time
+    StateEventType type;
+    int index;
+    char text[MAX_INPUT_LEN];
+} StateEvent;
+
+/* Everything replay rebuilds, as of event seq */
+typedef struct {
+    char magic[8];                // SNAPSHOT_MAGIC
+    int64_t seq;                  // Last event included
+    int64_t log_offset;           // events.log offset just past that event
+    int32_t num_tasks;
+    int32_t streak_max;
+    int32_t streak_current;
+    char last_session_day[DATE_STR_LEN + 1];
+    char focus_task[MAX_TASK_LEN];
+    Task tasks[MAX_TASKS];
+    DayStats day_stats;
+    char sealed_day[DATE_STR_LEN + 1];
+    uint32_t checksum;            // FNV-1a of everything above
+} Snapshot;
+
+/* The writer thread's queue holds these, each followed by len bytes of
+ * payload and padded to 8 bytes. A record is a copy of what to write, so
+ * the main thread can change the state it came from right away. */
+typedef enum {
+    PR_SKIP,            // Unused space up to the end of the ring
+    PR_EVENTS,          // Lines to append to events.log
+    PR_UNLOCK,          // The batch before this is done with the events.log lock
+    PR_SESSION_ROW,     // Line to append to sessions.csv
+    PR_DAY_ROW,         // Line to append to days.csv
+    PR_TASKS,           // All of tasks.txt
+    PR_META,            // StreakData
+    PR_SNAPSHOT,        // Snapshot
+    PR_CHECKPOINT,      // Checkpoint
+    PR_METRICS,         // All of the --metrics-file textfile
+    PR_STOP             // Last record; the writer thread exits
+} PersistType;
+
+typedef struct {
+    uint32_t type;                // PersistType
+    uint32_t len;                 // Payload bytes
+} PersistRecord;
+
+/* Observations per bucket of metrics_bounds_ns, not cumulative; the last
+ * bucket is +Inf. Updated with relaxed atomic adds, never locked. */
+typedef struct {
+    uint64_t buckets[METRICS_BUCKETS + 1];
+    uint64_t sum_ns;
+} Histogram;
+
+/* Counters and histograms; gauges are read from the state when scraped */
+typedef struct {
+    uint64_t sessions_logged;     // Main thread
+    Histogram keypress_latency;
+    uint64_t saves __attribute__((aligned(64)));  // Writer thread, on a line of its own
+    uint64_t bytes_written;
+    uint64_t fsyncs;
+    Histogram save_latency;
+} Metrics;
+
+/* One fixed-size slot, rewritten in place with a single pwrite() */
+typedef struct {
+    char magic[8];                // CHECKPOINT_MAGIC
+    int32_t state;                // SESSION_*; SESSION_INACTIVE means nothing to resume
+    int32_t reserved;
+    int64_t start_time;           // session_start_time
+    int64_t active_ns;            // Time the phase has run, as session_active_seconds()
+    int64_t remaining_ns;         // Time left until the phase deadline
+    int64_t written_at;           // Wall time of this checkpoint
+    char focus_task[MAX_TASK_LEN];
+    uint32_t checksum;            // FNV-1a of everything above
+    uint32_t pad;
+} Checkpoint;
+
+/* The status page: ~/.focusforge/status, mapped shared by its writer and
+ * every reader. Everything after seq is only valid read under the seqlock. */
+typedef struct {
+    char magic[8];                // STATUS_MAGIC
+    uint32_t seq;                 // Odd while the writer is mid-update
+    int32_t pid;                  // Process keeping the page current, 0 if none
+    int32_t state;                // SESSION_*
+    int32_t today_sessions;       // Sessions logged on date
+    int32_t streak;
+    int32_t reserved;
+    int64_t deadline_ns;          // CLOCK_MONOTONIC end of the phase; readers work out what is left
+    char date[DATE_STR_LEN + 1];  // Local date today_sessions and streak were computed for
+    char focus_task[MAX_TASK_LEN];
+} StatusPage;
+
+/* A client attached to the daemon's socket */
+typedef struct {
+    int fd;                       // -1 when the slot is free
+    EventSource *src;
+    char buf[MAX_INPUT_LEN + 8];  // Request line read so far
+    int len;
+    int hung_up;                  // Gone, but requests it sent before closing are still read
+} DaemonClient;
+
+/* A reader of the event feed */
+typedef struct {
+    int fd;                       // -1 when the slot is free
+    EventSource *src;
+    char *ring;                   // FEED_RING_SIZE bytes of whole lines not yet sent
+    int head;                     // Oldest unsent byte
+    int len;                      // Unsent bytes
+    long dropped;                 // Objects lost since the last one queued
+    int waiting;                  // Watching for EPOLLOUT
+} FeedSubscriber;
+
+/* A connection to --metrics-port, until its request is answered */
+typedef struct {
+    int fd;                       // -1 when the slot is free
+    EventSource *src;
+    Timer idle;                   // Drops a client that never finishes its request
+    char request[SCRAPE_REQUEST_SIZE];  // Header read so far
+    int len;
+} Scraper;
+
+/* One user of the --server; everything below lock is guarded by it */
+typedef struct Shard {
+    pthread_mutex_t lock;
+    char user[SHARD_NAME_LEN];
+    int events_fd;                // <root>/<user>/events.log
+    long long seq;                // Last event written or replayed
+    Task tasks[MAX_TASKS];
+    int num_tasks;
+    char focus_task[MAX_TASK_LEN];
+    int session_state;
+    long long deadline_ns;
+    long long start_mono_ns;
+    time_t start_time;
+    StreakData streaks;
+    char last_session_day[DATE_STR_LEN];
+    DayStats day_stats;
+    Timer phase_timer;            // In server_wheel while a session runs
+    struct Shard *next;           // Hash bucket chain
+} Shard;
+
+/* A --server connection; only the worker that epoll handed it to touches it */
+typedef struct {
+    int fd;
+    Shard *shard;                 // Selected by "user", NULL before
+    char account[SHARD_NAME_LEN]; // The only user a peer other than the server's owner may be
+    char buf[MAX_INPUT_LEN + 8];
+    int len;
+    char out[SERVER_REPLY_SIZE];  // Replies the client has not taken yet
+    int out_len;
+} ServerConn;
+
+typedef struct {
+    int fds[BENCH_SERVER_USERS];
+    int conn_count;
+    long long end_ns;
+    long requests;
+    long errors;
+    long long samples[BENCH_SERVER_SAMPLES];
+    int sample_count;
+} BenchServerThread;
+
+/* Every time source goes through one of these: the system clocks normally,
+ * the virtual clock under --simulate */
+typedef struct {
+    time_t (*wall)();            // Seconds since the epoch, as time(NULL)
+    long long (*monotonic)();    // CLOCK_MONOTONIC in ns; stops during suspend
+    long long (*boottime)();     // CLOCK_BOOTTIME in ns; runs through suspend
+} Clock;
+
 /* Function declarations */
 void safe_strncpy(char *dest, const char *src, size_t dest_size);
 int safe_strtol(const char *str, long *result);
@@ -67,6 +424,7 @@ void finish_command_input();
 void start_focus_session();
 void start_break_session();
 void stop_session();
+void end_session();
 void skip_session();
 void save_settings();
 void load_settings();
@@ -76,22 +434,77 @@ void add_task(const char *text);
 void mark_task_done(int index);
 void unmark_task(int index);
 void remove_task(int index);
+int task_pick(int index);
 void display_tasks();
 void save_tasks();
 void load_tasks();
+void data_watch_start();
+void on_data_dir_changed(int fd, uint32_t events, void *ctx);
+int tasks_file_read(Task *out, int *count, struct stat *st, uint32_t *hash);
+int tasks_parse(char *buf, Task *out);
+int tasks_equal(const Task *a, int count_a, const Task *b, int count_b);
+int tasks_find(const Task *list, int count, const char *text);
+void tasks_reload();
+int tasks_sync(const Task *target, int count);
 int validate_input(const char *input);
 int parse_command(char *input);
 void log_session();
-void update_streaks();
+void update_streaks(const char *day);
 int get_today_sessions_count();
 int get_current_streak();
-void display_sessions();
+int draw_history_view(WINDOW *win, int first, int rows);
+int draw_help_view(WINDOW *win, int first, int rows);
+void view_push(const char *title, int (*draw)(WINDOW *win, int first, int rows), int width);
+void view_open_window(View *view);
+void view_render(View *view);
+void view_pop();
+void view_handle_key(int ch);
+void views_stage();
+void views_resize();
+void key_show_help();
+void key_show_history();
 void display_help();
+void build_help_pad();
+void key_quit();
+void key_toggle_help();
+void key_toggle_overlay();
+void key_mark_done();
+void key_unmark();
+void key_remove();
+void key_move_up();
+void key_move_down();
+void key_set_focus();
 void initialize_directories();
 void free_resources();
-void signal_handler(int sig);
 void cleanup_and_exit(int sig);
-void resize_handler(int sig);
+void event_loop_init(const sigset_t *signals);
+EventSource *event_add(int fd, uint32_t events, EventHandler handler, void *ctx);
+void event_modify(EventSource *src, uint32_t events);
+void event_remove(EventSource *src);
+void event_loop_wait();
+void record_wakeup(long long now_ns);
+int wakeups_last_minute();
+void arm_wakeup_timer();
+void on_stdin_ready(int fd, uint32_t events, void *ctx);
+void on_wakeup_timer(int fd, uint32_t events, void *ctx);
+void on_signal(int fd, uint32_t events, void *ctx);
+void timer_init(Timer *timer, const char *name, TimerCallback callback, void *ctx);
+void timer_start(TimerWheel *wheel, Timer *timer, long long expires_ns);
+void timer_cancel(TimerWheel *wheel, Timer *timer);
+int timer_pending(const Timer *timer);
+void wheel_init(TimerWheel *wheel, long long now_ns);
+Timer **wheel_list(TimerWheel *wheel, int level, int slot);
+void wheel_place(TimerWheel *wheel, Timer *timer);
+long long wheel_next_tick(const TimerWheel *wheel, int *level);
+long long wheel_next_expiry_ns(const TimerWheel *wheel);
+int wheel_advance(TimerWheel *wheel, long long now_ns);
+void bench_timer_wheel_fire(Timer *timer, void *ctx);
+void bench_timer_wheel();
+void schedule_phase();
+void on_phase_expired(Timer *timer, void *ctx);
+void on_tick(Timer *timer, void *ctx);
+void on_notification_expired(Timer *timer, void *ctx);
+void on_redraw_due(Timer *timer, void *ctx);
 void run_timer();
 void show_notification(const char *message, int duration);
 void process_input(char *input);
@@ -104,6 +517,146 @@ void update_input_display();
 void show_notification_window(const char *message, int duration);
 int parse_csv_line(const char *line, char *date_part, char *time_part, int *duration, char *task_part);
 int is_date_valid(const char *date_str);
+time_t wall_time();
+long long monotonic_ns();
+long long boottime_ns();
+time_t system_wall_time();
+long long system_monotonic_ns();
+long long system_boottime_ns();
+time_t virtual_wall_time();
+long long virtual_monotonic_ns();
+long long virtual_boottime_ns();
+int remaining_seconds(long long deadline_ns, long long now_ns);
+long long next_tick_ns(long long deadline_ns, long long now_ns);
+long long session_active_ns();
+int session_active_seconds();
+void check_suspend_gap();
+void bench_timer_drift();
+int compare_long_long(const void *a, const void *b);
+long long percentile_ns(const long long *samples, int count, int pct);
+unsigned long thread_bytes_written();
+void frame_begin();
+void frame_end();
+void frame_key_received();
+void display_overlay();
+void dump_frame_stats();
+void draw_border(WINDOW *win);
+void detect_low_bandwidth();
+void dump_render_stats();
+void timers_init(long long now_ns);
+uint32_t fnv1a(const void *data, size_t len);
+uint32_t checkpoint_checksum(const Checkpoint *ckpt);
+void state_emit(StateEventType type, int index, const char *text);
+void state_apply(const StateEvent *ev, int live);
+int state_parse_event(char *line, StateEvent *ev);
+void state_flush();
+void state_write_batch();
+void state_snapshot();
+int state_load_snapshot(long long *offset);
+void state_bootstrap();
+long long state_replay(long long offset);
+void state_lock();
+int state_catch_up();
+void state_load();
+void save_meta();
+void *persist_reserve(PersistType type, uint32_t len);
+void persist_commit(uint32_t len);
+void persist_append_row(PersistType type, const char *text);
+void persist_kick();
+void persist_drain();
+int persist_consume();
+void persist_write(PersistType type, const char *data, uint32_t len);
+void persist_fail(const char *message);
+void persist_unlock();
+void *persist_writer(void *arg);
+void persist_start();
+void persist_stop();
+int stat_same(const struct stat *a, const struct stat *b);
+void seal_finished_day();
+void update_day_dates();
+void day_rollover();
+void schedule_midnight();
+void on_midnight(Timer *timer, void *ctx);
+void write_checkpoint();
+void on_checkpoint_due(Timer *timer, void *ctx);
+void offer_resume();
+long long sim_parse_duration(const char *text);
+void sim_advance(long long delta_ns);
+void sim_suspend(long long gap_ns);
+int sim_run(char **lines, int first, int last);
+void run_simulation(const char *script);
+void parse_arguments(int argc, char *argv[]);
+int daemon_address(struct sockaddr_un *addr);
+int daemon_connect();
+int daemon_listen(int backlog);
+void run_daemon(const sigset_t *signals);
+void on_listen_ready(int fd, uint32_t events, void *ctx);
+void on_client_ready(int fd, uint32_t events, void *ctx);
+void client_send(DaemonClient *client, const char *data, int len);
+void client_close(DaemonClient *client);
+void daemon_handle_request(DaemonClient *client, char *line);
+int daemon_format_state(char *buf, int size);
+void daemon_queue(const char *fmt, ...);
+void daemon_queue_event(const StateEvent *ev);
+void daemon_publish();
+int forward_to_daemon(const char *fmt, ...);
+void on_daemon_ready(int fd, uint32_t events, void *ctx);
+void client_apply_line(char *line);
+void feed_open();
+void feed_close();
+void on_feed_listen_ready(int fd, uint32_t events, void *ctx);
+void on_subscriber_ready(int fd, uint32_t events, void *ctx);
+void feed_drop_subscriber(FeedSubscriber *sub);
+int feed_push(FeedSubscriber *sub, const char *line, int len);
+void feed_flush(FeedSubscriber *sub);
+void feed_emit(const char *event, const char *fmt, ...);
+const char *json_escape(const char *text, char *out, int size);
+void feed_state_event(const StateEvent *ev, const char *old_task, int old_streak);
+void feed_phase();
+void metric_add(uint64_t *counter, uint64_t n);
+void histogram_observe(Histogram *hist, long long ns);
+int metrics_format(char *buf, int size);
+int metrics_format_histogram(char *buf, int size, const char *name, const char *help, const Histogram *hist);
+void metrics_open();
+void on_metrics_listen_ready(int fd, uint32_t events, void *ctx);
+void on_metrics_conn_ready(int fd, uint32_t events, void *ctx);
+void on_scraper_idle(Timer *timer, void *ctx);
+void scraper_close(Scraper *scraper);
+void on_metrics_file_due(Timer *timer, void *ctx);
+void status_open();
+int status_claim();
+void status_write(const StatusPage *next);
+void status_publish();
+void status_close();
+int status_read(const StatusPage *page, StatusPage *out);
+void bench_status_page();
+int run_status_query(const char *format);
+int state_format_event(const StateEvent *ev, char *line, int size);
+int streak_count_day(StreakData *streak, char *last_day, const char *day);
+void calendar_yesterday(const char *day, char *out);
+Shard *shard_get(const char *user);
+void shard_load(Shard *shard);
+void shard_apply(Shard *shard, const StateEvent *ev);
+void shard_emit(Shard *shard, StateEventType type, int index, const char *text);
+void shard_log_session(Shard *shard, long long now);
+void shard_schedule(Shard *shard);
+void shard_phase_due(Timer *timer, void *ctx);
+void shard_phase_expired(Shard *shard, long long now);
+int server_handle_line(ServerConn *conn, char *line, char *reply, int size);
+int server_user_valid(const char *name);
+int server_peer_account(int fd, char *account);
+void server_arm_timer();
+void *server_timer_thread(void *arg);
+void server_accept();
+void server_serve(ServerConn *conn);
+int server_flush(ServerConn *conn);
+void *server_worker(void *arg);
+void run_server(const sigset_t *signals);
+void *bench_server_client(void *arg);
+void bench_server();
+void stress_instance(int id, int report_fd);
+int stress_check(int ok, const char *what);
+void run_stress(int instances);
 
 /* Global variables */
 char focus_task[MAX_TASK_LEN] = "???";
@@ -114,23 +667,175 @@ char tasks_file[MAX_PATH_LEN];
 char sessions_file[MAX_PATH_LEN];
 char meta_file[MAX_PATH_LEN];
 char settings_file[MAX_PATH_LEN];
+char checkpoint_file[MAX_PATH_LEN];
+char events_file[MAX_PATH_LEN];
+char snapshot_file[MAX_PATH_LEN];
+char days_file[MAX_PATH_LEN];
+char socket_file[MAX_PATH_LEN];
+char feed_file[MAX_PATH_LEN];
+char status_file[MAX_PATH_LEN];
 time_t session_start_time;
 int session_state = SESSION_INACTIVE;  // Current session state
-int timer_seconds = FOCUS_DURATION;
-volatile sig_atomic_t running = 1;  // Use volatile for signal-safe access
-volatile sig_atomic_t resize_pending = 0;  // Flag for pending resize
+int timer_seconds = FOCUS_DURATION;  // Display value, derived from session_deadline_ns
+long long session_deadline_ns = 0;  // CLOCK_MONOTONIC time the current phase ends
+long long session_start_mono_ns = 0;  // CLOCK_MONOTONIC time the current phase began
+long long session_counted_gap_ns = 0;  // Suspend time counted under SUSPEND_COUNT
+long long suspend_offset_ns = 0;  // CLOCK_BOOTTIME - CLOCK_MONOTONIC at the last check
+int suspend_policy = SUSPEND_PAUSE;
+int running = 1;  // Cleared by 'q' or SIGINT/SIGTERM to leave the main loop
+int epoll_fd = -1;
+int wakeup_timer_fd = -1;  // timerfd armed for the next tick or expiry
+int signal_fd = -1;
+EventSource *event_sources = NULL;
+int event_sources_dead = 0;  // Removed sources waiting to be freed
+TimerWheel timer_wheel;  // Every timed event in the process
+Timer phase_timer;  // End of the current focus or break phase
+Timer tick_timer;  // Next change of the displayed countdown
+Timer notification_timer;  // Notification expiry
+Timer redraw_timer;  // Full redraw deferred by the low-bandwidth cap
+Timer checkpoint_timer;  // Next periodic checkpoint of the running session
+int checkpoint_fd = -1;  // session.ckpt, held open for the whole run
+int events_fd = -1;  // events.log, O_APPEND
+long long events_log_size = 0;  // Bytes in events.log, including flushed batches
+long long state_seq = 0;  // Last event applied
+int events_since_snapshot = 0;
+char event_batch[EVENT_BATCH_SIZE];  // Events not yet written to events.log
+int event_batch_len = 0;
+int tasks_dirty = 0;  // tasks.txt needs rewriting from state
+int data_watch_fd = -1;  // inotify on the data directory, -1 when not watching
+int events_locked = 0;  // This process holds the writer lock on events.log
+long events_lock_contended = 0;  // Times another instance held it when we wanted it
+int events_lock_refs = 0;  // Batches holding the lock, queued ones included; -1 while the writer drops it
+char persist_ring[PERSIST_RING_SIZE] __attribute__((aligned(8)));  // Records for the writer thread
+uint64_t persist_head = 0;  // Ring offset of the next record to write; advanced by the writer
+uint64_t persist_tail = 0;  // Ring offset just past the last committed record
+uint64_t persist_open = 0;  // Where the record being filled in begins
+int persist_running = 0;  // The writer thread is up; without it records are written at commit
+int persist_kick_pending = 0;  // Records committed since the writer was last woken
+int persist_wake_fd = -1;  // eventfd the writer thread sleeps on
+pthread_t persist_thread;
+const char *persist_error = NULL;  // The writer's last failure, for the main thread to show
+pthread_mutex_t tasks_written_lock = PTHREAD_MUTEX_INITIALIZER;
+struct stat tasks_written_stat;  // tasks.txt as the writer thread last left it
+int tasks_writes_pending = 0;  // PR_TASKS records queued and not yet published in tasks_written_stat
+int tasks_reload_deferred = 0;  // tasks_reload() was skipped for a pending write
+struct stat tasks_seen_stat;  // tasks.txt as we last wrote or read it
+uint32_t tasks_seen_hash = 0;
+Task tasks_saved[MAX_TASKS];  // The list it held then: the base outside edits are merged against
+int num_tasks_saved = 0;
+int meta_dirty = 0;  // meta needs rewriting from state
+StreakData streaks = {0, 0};  // As of state_seq; meta is written from this
+char last_session_day[DATE_STR_LEN] = "";  // Date of the newest logged session
+const char *state_event_names[EV_COUNT] = {
+    "task_add", "task_done", "task_undone", "task_remove", "task_edit", "task_insert", "focus",
+    "session_start", "session_stop", "session_skip", "session_log", "day_seal", "import"
+};
+DayStats day_stats = {"", 0, 0};  // Totals of the newest day with a logged session
+char sealed_day[DATE_STR_LEN] = "";  // Newest day whose rollup is in days.csv
+char today_date[DATE_STR_LEN] = "";  // Local date, moved on only by day_rollover()
+char yesterday_date[DATE_STR_LEN] = "";
+Timer midnight_timer;  // Next local midnight
+View views[MAX_VIEWS];  // Open modal views, top of the stack last
+int view_count = 0;
+long long wakeup_times_ns[WAKEUP_SAMPLES];  // Ring of recent epoll_wait() returns
+long long wakeups_total = 0;
 WINDOW *main_win = NULL;
 WINDOW *timer_win = NULL;
 WINDOW *tasks_win = NULL;
 WINDOW *input_win = NULL;
 WINDOW *help_win = NULL;
+WINDOW *help_pad = NULL;  // Pre-rendered help text, blitted into help_win
+int help_pad_lines = 0;
 WINDOW *notification_win = NULL;
 int show_help = 1;  // Help is always shown now
 char input_buffer[MAX_INPUT_LEN] = {0};  // Buffer for incremental input
 int input_pos = 0;  // Current position in input buffer
 int input_mode = 0;  // 0 = normal, 1 = entering command
-time_t notification_end_time = 0;  // When to hide notification
+long long notification_end_ns = 0;  // CLOCK_MONOTONIC time to hide the notification
 int current_task_index = 0;  // Currently selected task for quick operations
+WINDOW *overlay_win = NULL;
+char timer_drawn[TIMER_TEXT_LEN] = "";  // Timer text currently on screen
+int timer_drawn_x = -1;  // Column of timer_drawn, -1 forces a full redraw
+int input_drawn_mode = -1;  // input_mode currently on screen, -1 forces a full redraw
+int input_drawn_len = 0;  // Buffer characters currently visible in the field
+int input_scroll = 0;  // Index of the first visible buffer character
+int show_overlay = 0;  // Frame-timing overlay, toggled with 'p'
+FrameStats frame_stats;
+int frame_depth = 0;  // Nesting level of frame_begin()/frame_end()
+long long frame_start_ns = 0;
+unsigned long tty_bytes_written = 0;  // Everything doupdate() wrote to the tty
+int thread_io_fd = -1;  // /proc/thread-self/io, source of the byte counts
+int frame_stats_on_exit = 0;  // --frame-stats
+const char *latency_dump_file = NULL;  // --latency-dump=FILE
+int low_bandwidth = 0;  // --low-bandwidth, FOCUSFORGE_LOW_BANDWIDTH or a slow tty
+int render_stats_on_exit = 0;  // --render-stats
+long long last_full_redraw_ns = 0;
+long full_redraws = 0;
+long deferred_redraws = 0;
+long long render_start_ns = 0;
+const Clock system_clock = { system_wall_time, system_monotonic_ns, system_boottime_ns };
+const Clock virtual_clock = { virtual_wall_time, virtual_monotonic_ns, virtual_boottime_ns };
+const Clock *active_clock = &system_clock;
+long long virtual_wall_ns = 0;  // Only moved by the simulation script
+long long virtual_mono_ns = 0;
+long long virtual_boot_ns = 0;
+int headless = 0;  // No terminal: drawing is skipped, notifications go to clients or the trace
+const char *data_dir = NULL;  // --data-dir=DIR instead of ~/.focusforge
+const char *simulate_script = NULL;  // --simulate=SCRIPT
+int sim_trace = 0;  // Echo notifications while simulating
+int sim_failures = 0;  // Failed 'expect' lines
+long sessions_logged = 0;  // Focus sessions written by this process
+int daemon_mode = 0;  // --daemon
+int listen_fd = -1;  // Daemon: the socket clients connect to
+DaemonClient clients[MAX_CLIENTS];
+DaemonClient *requesting_client = NULL;  // Daemon: client whose command is running
+StatusPage published = { .state = -1 };  // Daemon: phase and figures every client has
+char client_diff[DAEMON_BUF_SIZE];  // Daemon: diff lines for the next daemon_publish()
+int client_diff_len = 0;  // -1 if they overflowed and a full state goes out instead
+char daemon_out[DAEMON_BUF_SIZE];  // Daemon: formatted state update
+int daemon_fd = -1;  // Client: connection to the daemon, -1 when standalone
+char daemon_in[DAEMON_BUF_SIZE];  // Client: bytes from the daemon not yet parsed
+int daemon_in_len = 0;
+int daemon_lost = 0;  // Client: the daemon went away
+int daemon_streak = 0;  // Client: figures as the daemon last sent them
+int daemon_today = 0;
+StatusPage *status_page = NULL;  // Mapped by the process that owns the state
+int status_fd = -1;  // Kept open: its flock marks the one process writing the page
+int feed_listen_fd = -1;  // Event feed socket, served by the status page's writer
+int feed_tried = 0;  // feed_open() runs once, when this process first owns the page
+FeedSubscriber subscribers[MAX_SUBSCRIBERS];
+int feed_subscriber_count = 0;
+long long feed_seq = 0;
+Metrics metrics;
+const long long metrics_bounds_ns[METRICS_BUCKETS] = {
+    100000LL, 250000LL, 500000LL, 1000000LL, 2500000LL, 5000000LL,
+    10000000LL, 25000000LL, 50000000LL, 100000000LL, 250000000LL, 1000000000LL
+};
+int metrics_port = 0;  // --metrics-port=PORT, served on 127.0.0.1
+const char *metrics_file = NULL;  // --metrics-file=PATH, a node_exporter textfile
+int metrics_listen_fd = -1;
+Scraper scrapers[MAX_SCRAPERS];
+int metrics_tried = 0;  // metrics_open() runs once, like feed_open()
+Timer metrics_file_timer;
+int state_catching_up = 0;  // Applying events another instance wrote
+int status_query = 0;  // --status
+const char *status_format = "%p %r today:%t";  // --format=
+int server_mode = 0;  // --server, or -1 for --bench-server
+int stress_instances = 0;  // --stress=N
+int server_workers = 0;  // --workers=N; 0 means one per CPU
+char server_root[MAX_PATH_LEN];  // Server: holds a directory per user
+int server_listen_fd = -1;
+int server_epoll_fd = -1;  // Server: listener and connections, shared by the workers
+int server_timer_fd = -1;  // Server: fires at server_wheel's next expiry
+pthread_mutex_t shard_table_lock = PTHREAD_MUTEX_INITIALIZER;
+Shard *shard_table[SHARD_BUCKETS];
+long shard_count = 0;
+pthread_mutex_t server_wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+TimerWheel server_wheel;  // Phase timers of every shard
+Shard **server_due = NULL;  // Server timer thread: shards whose timer fired
+int server_due_count = 0;
+int server_due_capacity = 0;
+BenchServerThread bench_server_threads[BENCH_SERVER_THREADS];
 
 /* Display symbols for different modes - ASCII only */
 const char *FOCUS_SYMBOLS = "[FOCUS";
@@ -188,11 +893,14 @@ int validate_task_number(const char *str, int *result) {
 void clear_input_buffer() {
     memset(input_buffer, 0, sizeof(input_buffer));
     input_pos = 0;
+    input_scroll = 0;
+    input_drawn_mode = -1;
 }
 
 void start_command_input() {
     input_mode = 1;
     clear_input_buffer();
+    update_input_display();
 }
 
 void finish_command_input() {
@@ -201,60 +909,98 @@ void finish_command_input() {
         input_buffer[input_pos] = '\0';
         process_input(input_buffer);
         clear_input_buffer();
+        display_screen();  // The command may have changed tasks or the session
+        return;
     }
+    update_input_display();
 }
 
 void start_focus_session() {
+    if (forward_to_daemon("cmd f")) {
+        return;
+    }
+    
     if (session_state != SESSION_INACTIVE) {
         show_notification("Session already active", 2);
         return;
     }
     
     session_state = SESSION_FOCUS;
-    session_start_time = time(NULL);
+    state_emit(EV_SESSION_START, SESSION_FOCUS, focus_task);
+    session_start_time = wall_time();
+    session_start_mono_ns = monotonic_ns();
+    session_counted_gap_ns = 0;
+    session_deadline_ns = session_start_mono_ns + FOCUS_DURATION * NS_PER_SEC;
     timer_seconds = FOCUS_DURATION;
+    schedule_phase();
     show_notification("Focus session started", 2);
     display_screen();
 }
 
 void start_break_session() {
+    if (forward_to_daemon("cmd b")) {
+        return;
+    }
+    
     if (session_state != SESSION_INACTIVE) {
         show_notification("Session already active", 2);
         return;
     }
     
     session_state = SESSION_BREAK;
-    session_start_time = time(NULL);
+    state_emit(EV_SESSION_START, SESSION_BREAK, "");
+    session_start_time = wall_time();
+    session_start_mono_ns = monotonic_ns();
+    session_counted_gap_ns = 0;
+    session_deadline_ns = session_start_mono_ns + BREAK_DURATION * NS_PER_SEC;
     timer_seconds = BREAK_DURATION;
+    schedule_phase();
     show_notification("Break session started", 2);
     display_screen();
 }
 
 void stop_session() {
+    if (forward_to_daemon("cmd s")) {
+        return;
+    }
+    
     if (session_state == SESSION_INACTIVE) {
         show_notification("No active session", 2);
         return;
     }
     
-    if (session_state == SESSION_FOCUS) {
+    end_session();
+    show_notification("Session stopped", 2);
+    display_screen();
+}
+
+// Stop the running phase, logging a focus session that actually ran
+void end_session() {
+    if (session_state == SESSION_FOCUS && session_active_seconds() > 0) {
         log_session();
     }
     
+    state_emit(EV_SESSION_STOP, session_state, "");
     session_state = SESSION_INACTIVE;
     timer_seconds = FOCUS_DURATION;
-    show_notification("Session stopped", 2);
-    display_screen();
+    schedule_phase();
 }
 
 void skip_session() {
+    if (forward_to_daemon("cmd d")) {
+        return;
+    }
+    
     if (session_state == SESSION_INACTIVE) {
         show_notification("No active session", 2);
         return;
     }
     
+    state_emit(EV_SESSION_SKIP, session_state, "");
     if (session_state == SESSION_FOCUS) {
         log_session();
         session_state = SESSION_BREAK;
+        session_deadline_ns = monotonic_ns() + BREAK_DURATION * NS_PER_SEC;
         timer_seconds = BREAK_DURATION;
         show_notification("Focus session completed. Break started.", 2);
     } else if (session_state == SESSION_BREAK) {
@@ -262,12 +1008,16 @@ void skip_session() {
         timer_seconds = FOCUS_DURATION;
         show_notification("Break completed. Ready for next focus session.", 2);
     }
+    schedule_phase();
     display_screen();
 }
 
+const char *suspend_policy_names[] = { "pause", "count", "end" };
+
 void save_settings() {
     FILE *fp = fopen(settings_file, "w");
     if (fp) {
+        fprintf(fp, "suspend_policy=%s\n", suspend_policy_names[suspend_policy]);
         if (fclose(fp) != 0) {
             LOG_ERROR("Failed to close settings file");
         }
@@ -281,7 +1031,18 @@ void load_settings() {
     if (fp) {
         char line[256];
         while (fgets(line, sizeof(line), fp)) {
-            // No settings to load anymore since we removed display mode
+            char *newline = strchr(line, '\n');
+            if (newline) {
+                *newline = '\0';
+            }
+            
+            if (strncmp(line, "suspend_policy=", 15) == 0) {
+                for (int i = SUSPEND_PAUSE; i <= SUSPEND_END; i++) {
+                    if (strcmp(line + 15, suspend_policy_names[i]) == 0) {
+                        suspend_policy = i;
+                    }
+                }
+            }
         }
         if (fclose(fp) != 0) {
             LOG_WARN("Failed to close settings file");
@@ -289,113 +1050,143 @@ void load_settings() {
     }
 }
 
-void handle_key_input(int ch) {
-    // Handle ESC key to cancel input
-    if (ch == 27) {
-        input_mode = 0;
-        clear_input_buffer();
+void key_quit() {
+    running = 0;
+}
+
+void key_show_help() {
+    view_push("Help", draw_help_view, HELP_WIDTH);
+}
+
+void key_show_history() {
+    view_push("Today's sessions", draw_history_view, HISTORY_WIDTH);
+}
+
+void key_toggle_help() {
+    show_help = !show_help;
+    display_screen();
+}
+
+void key_toggle_overlay() {
+    show_overlay = !show_overlay;
+    display_screen();
+}
+
+void key_mark_done() {
+    if (num_tasks > 0) {
+        mark_task_done(current_task_index);
+        // Move to next task if available
+        if (current_task_index < num_tasks - 1) {
+            current_task_index++;
+        }
         display_screen();
-        return;
     }
-    
-    // Handle direct quit only when not in input mode
-    if (!input_mode && (ch == 'q' || ch == 'Q')) {
-        running = 0;
+}
+
+void key_unmark() {
+    if (num_tasks > 0) {
+        unmark_task(current_task_index);
+        display_screen();
+    }
+}
+
+void key_remove() {
+    if (num_tasks > 0) {
+        remove_task(current_task_index);
+        // Adjust selection if needed
+        if (current_task_index >= num_tasks && current_task_index > 0) {
+            current_task_index--;
+        }
+        display_screen();
+    }
+}
+
+void key_move_up() {
+    if (current_task_index > 0) {
+        current_task_index--;
+        display_screen();
+    }
+}
+
+void key_move_down() {
+    if (current_task_index < num_tasks - 1) {
+        current_task_index++;
+        display_screen();
+    }
+}
+
+void key_set_focus() {
+    if (num_tasks > 0) {
+        if (!forward_to_daemon("cmd t %s", tasks[current_task_index].task)) {
+            state_emit(EV_FOCUS, 0, tasks[current_task_index].task);
+            show_notification("Focus task updated", 2);
+        }
+        display_screen();
+    }
+}
+
+/* Single-key commands, optimized for the Finnish QWERTY home row.
+ * handle_key_input() dispatches on this table and build_help_pad() renders
+ * it, so the help panel always matches the keys that actually work. */
+const KeyBinding key_bindings[] = {
+    // Session controls - left hand home row
+    { 'a', 0, "a", "Start focus session", HELP_SECTION_SESSION, start_focus_session },
+    { 'f', 0, "f", "Start break session", HELP_SECTION_SESSION, start_break_session },
+    { 's', 0, "s", "Stop/pause session", HELP_SECTION_SESSION, stop_session },
+    { 'd', 0, "d", "Skip current session", HELP_SECTION_SESSION, skip_session },
+    
+    // Task controls - right hand home row
+    { '\n', '\r', "Enter", "Add new task", HELP_SECTION_TASK, start_command_input },
+    { ' ', 0, "Space", "Set focus task", HELP_SECTION_TASK, key_set_focus },
+    { 'j', 0, "j", "Mark task done", HELP_SECTION_TASK, key_mark_done },
+    { 'k', 0, "k", "Unmark task", HELP_SECTION_TASK, key_unmark },
+    { 'l', 0, "l", "Remove task", HELP_SECTION_TASK, key_remove },
+    { 'w', 0, "w", "Move up in task list", HELP_SECTION_TASK, key_move_up },
+    { 'x', 0, "x", "Move down in task list", HELP_SECTION_TASK, key_move_down },
+    
+    // Other
+    { 'q', 0, "q", "Quit", HELP_SECTION_OTHER, key_quit },
+    { '?', 0, "?", "Help", HELP_SECTION_OTHER, key_show_help },
+    { 'h', 0, "h", "Toggle help pane", HELP_SECTION_OTHER, key_toggle_help },
+    { 'g', 0, "g", "Today's session log", HELP_SECTION_OTHER, key_show_history },
+    { 'p', 0, "p", "Frame timing overlay", HELP_SECTION_OTHER, key_toggle_overlay },
+};
+
+const char *help_section_titles[] = { "SESSION COMMANDS:", "TASK COMMANDS:", "OTHER:" };
+
+const char *help_tips[] = {
+    "* Work 25 min, break 5 min",
+    "* After 4 sessions, take",
+    "  a longer break (15-30 min)",
+    "* Stay focused on one task",
+    "* Avoid distractions",
+};
+
+void handle_key_input(int ch) {
+    // An open view takes every key until it is closed
+    if (view_count > 0) {
+        view_handle_key(ch);
         return;
     }
     
-    // Handle help toggle
-    if (!input_mode && (ch == '?' || ch == 'h' || ch == 'H')) {
-        show_help = !show_help;
+    // Handle ESC key to cancel input
+    if (ch == 27) {
+        input_mode = 0;
+        clear_input_buffer();
         display_screen();
         return;
     }
     
-    // Only process input when in input mode
+    // Single-key commands come from the key table, which also feeds the help panel
     if (!input_mode) {
-        // Single-key commands for Finnish QWERTY keyboard optimization
-        switch (ch) {
-            // Session controls - left hand home row
-            case 'a':  // Start focus session (A is in home row)
-            case 'A':
-                start_focus_session();
-                return;
-            case 's':  // Stop session (S is in home row)
-            case 'S':
-                stop_session();
-                return;
-            case 'd':  // Skip session (D is in home row)
-            case 'D':
-                skip_session();
-                return;
-            case 'f':  // Start break session (F is in home row)
-            case 'F':
-                start_break_session();
-                return;
-                
-            // Task controls - right hand home row
-            case 'j':  // Mark task done (J is in home row)
-            case 'J':
-                if (num_tasks > 0) {
-                    mark_task_done(current_task_index);
-                    // Move to next task if available
-                    if (current_task_index < num_tasks - 1) {
-                        current_task_index++;
-                    }
-                    display_screen();
-                }
-                return;
-            case 'k':  // Unmark task (K is in home row)
-            case 'K':
-                if (num_tasks > 0) {
-                    unmark_task(current_task_index);
-                    display_screen();
-                }
-                return;
-            case 'l':  // Remove task (L is in home row)
-            case 'L':
-                if (num_tasks > 0) {
-                    remove_task(current_task_index);
-                    // Adjust selection if needed
-                    if (current_task_index >= num_tasks && current_task_index > 0) {
-                        current_task_index--;
-                    }
-                    display_screen();
-                }
-                return;
-                
-            // Navigation
-            case 'w':  // Move up in task list (W is in home row)
-            case 'W':
-                if (current_task_index > 0) {
-                    current_task_index--;
-                    display_screen();
-                }
-                return;
-            case 'x':  // Move down in task list (X is near home row)
-            case 'X':
-                if (current_task_index < num_tasks - 1) {
-                    current_task_index++;
-                    display_screen();
-                }
-                return;
-                
-            // Quick add task (Enter key)
-            case '\n':
-            case '\r':
-                start_command_input();
-                return;
-                
-            // Quick set focus task (Space key)
-            case ' ':
-                if (num_tasks > 0) {
-                    safe_strncpy(focus_task, tasks[current_task_index].task, MAX_TASK_LEN);
-                    show_notification("Focus task updated", 2);
-                    display_screen();
-                }
+        int lower = (ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch;
+        for (size_t i = 0; i < sizeof(key_bindings) / sizeof(key_bindings[0]); i++) {
+            const KeyBinding *kb = &key_bindings[i];
+            if (lower == kb->key || (kb->alt_key != 0 && lower == kb->alt_key)) {
+                kb->action();
                 return;
+            }
         }
-        
         return;
     }
     
@@ -441,23 +1232,28 @@ void add_task(const char *text) {
         return;
     }
     
+    if (forward_to_daemon("cmd a %s", text)) {
+        return;
+    }
+    
+    state_lock();
     if (num_tasks >= MAX_TASKS) {
         show_notification("Maximum number of tasks reached", 2);
         return;
     }
     
-    // Use safe string copy
-    safe_strncpy(tasks[num_tasks].task, text, MAX_TASK_LEN);
-    tasks[num_tasks].done = 0;
-    num_tasks++;
-    save_tasks();
+    state_emit(EV_TASK_ADD, 0, text);
     show_notification("Task added", 2);
 }
 
 void mark_task_done(int index) {
-    if (index >= 0 && index < num_tasks) {
-        tasks[index].done = 1;
-        save_tasks();
+    if (forward_to_daemon("cmd d %d", index + 1)) {
+        return;
+    }
+    
+    index = task_pick(index);
+    if (index != -1) {
+        state_emit(EV_TASK_DONE, index, "");
         show_notification("Task marked as done", 2);
     } else {
         show_notification("Invalid task number", 2);
@@ -465,9 +1261,13 @@ void mark_task_done(int index) {
 }
 
 void unmark_task(int index) {
-    if (index >= 0 && index < num_tasks) {
-        tasks[index].done = 0;
-        save_tasks();
+    if (forward_to_daemon("cmd u %d", index + 1)) {
+        return;
+    }
+    
+    index = task_pick(index);
+    if (index != -1) {
+        state_emit(EV_TASK_UNDONE, index, "");
         show_notification("Task unmarked", 2);
     } else {
         show_notification("Invalid task number", 2);
@@ -475,31 +1275,48 @@ void unmark_task(int index) {
 }
 
 void remove_task(int index) {
-    if (index >= 0 && index < num_tasks) {
-        // Shift all tasks after the removed task up by one
-        for (int i = index; i < num_tasks - 1; i++) {
-            tasks[i] = tasks[i + 1];
-        }
-        num_tasks--;
-        save_tasks();
+    if (forward_to_daemon("cmd r %d", index + 1)) {
+        return;
+    }
+    
+    index = task_pick(index);
+    if (index != -1) {
+        state_emit(EV_TASK_REMOVE, index, "");
         show_notification("Task removed", 2);
     } else {
         show_notification("Invalid task number", 2);
     }
 }
 
+/* Take the log lock and return where the task shown at index is now, or -1.
+ * Taking the lock applies what other instances appended, which can move or
+ * remove the task; the index alone would then name a different one. */
+int task_pick(int index) {
+    char picked[MAX_TASK_LEN];
+    picked[0] = '\0';
+    if (index >= 0 && index < num_tasks) {
+        safe_strncpy(picked, tasks[index].task, MAX_TASK_LEN);
+    }
+    
+    state_lock();
+    if (index >= 0 && index < num_tasks && (picked[0] == '\0' || strcmp(tasks[index].task, picked) == 0)) {
+        return index;
+    }
+    return picked[0] == '\0' ? -1 : tasks_find(tasks, num_tasks, picked);
+}
+
 void display_tasks() {
     if (tasks_win == NULL) {
         return;
     }
     
     werase(tasks_win);
-    box(tasks_win, 0, 0);
+    draw_border(tasks_win);
     mvwprintw(tasks_win, 1, 1, "TASKS:");
     
     int max_y = getmaxy(tasks_win);
     if (max_y <= 3) {
-        wrefresh(tasks_win);
+        wnoutrefresh(tasks_win);
         return;
     }
     
@@ -519,850 +1336,4586 @@ void display_tasks() {
         }
     }
     
-    wrefresh(tasks_win);
+    wnoutrefresh(tasks_win);
 }
 
+// Queue tasks.txt for the writer thread
 void save_tasks() {
-    FILE *fp = fopen(tasks_file, "w");
-    if (fp == NULL) {
-        LOG_ERROR("Failed to open tasks file for writing");
-        return;
-    }
-    
+    int size = num_tasks * (MAX_TASK_LEN + 8) + 1;
+    char *buf = persist_reserve(PR_TASKS, size);
+    int len = 0;
     for (int i = 0; i < num_tasks; i++) {
-        fprintf(fp, "[%c] %s\n", tasks[i].done ? 'X' : ' ', tasks[i].task);
+        len += snprintf(buf + len, size - len, "[%c] %s\n", tasks[i].done ? 'X' : ' ', tasks[i].task);
     }
     
-    if (fclose(fp) != 0) {
-        LOG_ERROR("Failed to close tasks file");
-    }
+    // Remember what we wrote, so the inotify event it raises is recognised as ours
+    tasks_seen_hash = fnv1a(buf, len);
+    memcpy(tasks_saved, tasks, num_tasks * sizeof(Task));
+    num_tasks_saved = num_tasks;
+    __atomic_fetch_add(&tasks_writes_pending, 1, __ATOMIC_RELEASE);
+    persist_commit(len);
 }
 
 void load_tasks() {
-    FILE *fp = fopen(tasks_file, "r");
-    if (fp == NULL) {
-        return;  // If file doesn't exist, just return with empty task list
+    struct stat st;
+    uint32_t hash;
+    tasks_file_read(tasks, &num_tasks, &st, &hash);  // If file doesn't exist, the task list stays empty
+}
+
+/* tasks.txt may be edited by hand or by scripts while FocusForge runs. The
+ * data directory is watched with inotify; a close after writing, or a
+ * rename onto tasks.txt, brings the file in through tasks_reload(). Our own
+ * writes are recognised by size, mtime and hash and cost nothing more.
+ * Appends to events.log by other instances are applied as they land. */
+void data_watch_start() {
+    // The log is the record at startup: a file that disagrees is rewritten.
+    // Compare it as the views state_load() queued left it
+    persist_drain();
+    Task incoming[MAX_TASKS];
+    int count;
+    if (tasks_file_read(incoming, &count, &tasks_seen_stat, &tasks_seen_hash) && tasks_equal(incoming, count, tasks, num_tasks)) {
+        memcpy(tasks_saved, incoming, count * sizeof(Task));
+        num_tasks_saved = count;
+    } else {
+        tasks_dirty = 1;
     }
     
-    char line[MAX_INPUT_LEN];
-    num_tasks = 0;
-    
-    while (fgets(line, sizeof(line), fp) != NULL && num_tasks < MAX_TASKS) {
-        // Parse the line format: [ ] or [x] followed by task text
-        if (strlen(line) >= 4 && line[0] == '[' && line[2] == ']') {
-            tasks[num_tasks].done = (line[1] == 'X') ? 1 : 0;
-            
-            // Extract the task text (skip the "[X] " part)
-            char *task_start = line + 4;
-            // Remove newline if present
-            char *newline = strchr(task_start, '\n');
-            if (newline) {
-                *newline = '\0';
+    data_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (data_watch_fd == -1 || inotify_add_watch(data_watch_fd, focusforge_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY) == -1 ||
+        event_add(data_watch_fd, EPOLLIN, on_data_dir_changed, NULL) == NULL) {
+        LOG_WARN("Cannot watch tasks.txt; outside edits will be overwritten");
+        if (data_watch_fd != -1) {
+            close(data_watch_fd);
+            data_watch_fd = -1;
+        }
+    }
+}
+
+void on_data_dir_changed(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int tasks_changed = 0;
+    int log_grew = 0;
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                tasks_changed = log_grew = 1;
+            } else if (ev->len > 0 && strcmp(ev->name, "tasks.txt") == 0 && !(ev->mask & IN_MODIFY)) {
+                tasks_changed = 1;
+            } else if (ev->len > 0 && strcmp(ev->name, "events.log") == 0) {
+                log_grew = 1;
             }
-            
-            if (task_start == NULL) continue;
-            
-            // Use safe string copy
-            safe_strncpy(tasks[num_tasks].task, task_start, MAX_TASK_LEN);
-            num_tasks++;
         }
     }
     
-    if (fclose(fp) != 0) {
-        LOG_WARN("Failed to close tasks file");
+    // The log first: its writer has rewritten tasks.txt from it by now
+    if (log_grew && state_catch_up()) {
+        display_screen();
+    }
+    if (tasks_changed) {
+        tasks_reload();
     }
 }
 
-int validate_input(const char *input) {
-    if (input == NULL || strlen(input) == 0) {
-        return 0;  // Invalid input
+// Whole file into out; 0 if it cannot be read
+int tasks_file_read(Task *out, int *count, struct stat *st, uint32_t *hash) {
+    static char buf[MAX_TASKS * (MAX_TASK_LEN + 8)];
+    int fd = open(tasks_file, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
     }
     
-    // Check for buffer overflow attempts
-    if (strlen(input) >= MAX_INPUT_LEN) {
-        return 0;  // Input too long
+    ssize_t len = 0;
+    ssize_t got;
+    if (fstat(fd, st) == -1) {
+        close(fd);
+        return 0;
     }
+    while (len < (ssize_t)sizeof(buf) - 1 && (got = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) {
+        len += got;
+    }
+    close(fd);
     
-    return 1;  // Valid input
+    buf[len] = '\0';
+    *hash = fnv1a(buf, len);
+    *count = tasks_parse(buf, out);
+    return 1;
 }
 
-// Simplified command parsing with better structure
-typedef enum {
-    CMD_NONE,
-    CMD_ADD_TASK,
-    CMD_SET_FOCUS,
-    CMD_MARK_DONE,
-    CMD_UNMARK,
-    CMD_REMOVE,
-    CMD_START_FOCUS,
-    CMD_START_BREAK,
-    CMD_STOP,
-    CMD_SKIP,
-    CMD_QUIT,
-    CMD_HELP
-} CommandType;
-
-typedef struct {
-    CommandType type;
-    char argument[MAX_INPUT_LEN];
-} ParsedCommand;
+// Lines of "[ ] task" or "[X] task"; a bare line, as `echo task >> tasks.txt` leaves, is an open task
+int tasks_parse(char *buf, Task *out) {
+    int count = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(buf, "\n", &save); line != NULL && count < MAX_TASKS; line = strtok_r(NULL, "\n", &save)) {
+        line[strcspn(line, "\r")] = '\0';
+        if (strlen(line) >= 4 && line[0] == '[' && line[2] == ']' && line[3] == ' ') {
+            out[count].done = line[1] == 'X' || line[1] == 'x';
+            line += 4;
+        } else {
+            out[count].done = 0;
+        }
+        if (line[0] != '\0') {
+            safe_strncpy(out[count].task, line, MAX_TASK_LEN);
+            count++;
+        }
+    }
+    return count;
+}
 
-int parse_command_input(const char *input, ParsedCommand *cmd) {
-    if (!validate_input(input) || !cmd) {
+int tasks_equal(const Task *a, int count_a, const Task *b, int count_b) {
+    if (count_a != count_b) {
         return 0;
     }
+    for (int i = 0; i < count_a; i++) {
+        if (a[i].done != b[i].done || strcmp(a[i].task, b[i].task) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Same file, same size, same mtime
+int stat_same(const struct stat *a, const struct stat *b) {
+    return a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+int tasks_find(const Task *list, int count, const char *text) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(list[i].task, text) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Bring in tasks.txt if it changed since we last wrote or read it. The
+ * file wins, except where FocusForge changed a row the file did not touch:
+ * rows added, removed or checked in the app since the last write are kept.
+ * Only the rows that differ are changed, through the usual events. */
+void tasks_reload() {
+    static int reloading = 0;
+    struct stat st;
+    if (reloading || data_watch_fd == -1) {
+        return;
+    }
     
-    // Initialize command
-    cmd->type = CMD_NONE;
-    cmd->argument[0] = '\0';
-    
-    // Make a copy of input to work with
-    char cmd_copy[MAX_INPUT_LEN];
-    safe_strncpy(cmd_copy, input, sizeof(cmd_copy));
+    // Until our queued writes land the file is older than tasks_saved, and
+    // would read as an outside edit; the rename that ends them brings us back
+    tasks_reload_deferred = __atomic_load_n(&tasks_writes_pending, __ATOMIC_ACQUIRE) > 0;
+    if (tasks_reload_deferred || stat(tasks_file, &st) == -1) {
+        return;  // A deleted file is written again at the next change
+    }
+    if (stat_same(&st, &tasks_seen_stat)) {
+        return;
+    }
     
-    // Remove trailing newline if present
-    char *newline = strchr(cmd_copy, '\n');
-    if (newline) *newline = '\0';
-    newline = strchr(cmd_copy, '\r');
-    if (newline) *newline = '\0';
+    // Our own write, as the writer thread left it
+    pthread_mutex_lock(&tasks_written_lock);
+    int ours = stat_same(&st, &tasks_written_stat);
+    pthread_mutex_unlock(&tasks_written_lock);
+    if (ours) {
+        tasks_seen_stat = st;
+        return;
+    }
     
-    // Skip leading whitespace
-    char *cmd_str = cmd_copy;
-    while (*cmd_str == ' ' || *cmd_str == '\t') {
-        cmd_str++;
+    // The merge and the events it emits index tasks[], so it must not move
+    // underneath them: take the lock, with what others appended, up front
+    state_lock();
+    
+    static Task incoming[MAX_TASKS];
+    static Task target[MAX_TASKS];
+    int count;
+    uint32_t hash;
+    if (!tasks_file_read(incoming, &count, &st, &hash)) {
+        return;
+    }
+    uint32_t old_hash = tasks_seen_hash;
+    tasks_seen_stat = st;
+    tasks_seen_hash = hash;
+    if (hash == old_hash) {
+        return;  // Touched or rewritten unchanged
     }
     
-    if (*cmd_str == '\0') {
-        return 1;  // Empty command, valid but no action
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        int base = tasks_find(tasks_saved, num_tasks_saved, incoming[i].task);
+        int mine = tasks_find(tasks, num_tasks, incoming[i].task);
+        target[n] = incoming[i];
+        if (base != -1 && tasks_saved[base].done == incoming[i].done) {
+            if (mine == -1) {
+                continue;  // Removed here, untouched there
+            }
+            target[n].done = tasks[mine].done;
+        }
+        n++;
+    }
+    for (int i = 0; i < num_tasks && n < MAX_TASKS; i++) {
+        if (tasks_find(tasks_saved, num_tasks_saved, tasks[i].task) == -1 &&
+            tasks_find(incoming, count, tasks[i].task) == -1) {
+            target[n++] = tasks[i];  // Added here since the last write
+        }
     }
     
-    // Check for single character commands
-    if (strlen(cmd_str) == 1) {
-        switch (cmd_str[0]) {
-            case 'f':
-                cmd->type = CMD_START_FOCUS;
-                return 1;
-            case 'b':
-                cmd->type = CMD_START_BREAK;
-                return 1;
-            case 's':
-                cmd->type = CMD_STOP;
-                return 1;
-            case 'd':
-                cmd->type = CMD_SKIP;
-                return 1;
-            case 'q':
-                cmd->type = CMD_QUIT;
-                return 1;
-            case 'h':
-            case '?':
-                cmd->type = CMD_HELP;
-                return 1;
+    memcpy(tasks_saved, incoming, count * sizeof(Task));
+    num_tasks_saved = count;
+    
+    reloading = 1;
+    int changes = tasks_sync(target, n);
+    reloading = 0;
+    
+    // The file already says this, and an editor holding it should not see it rewritten
+    if (tasks_equal(target, n, incoming, count)) {
+        tasks_dirty = 0;
+    }
+    if (current_task_index >= num_tasks) {
+        current_task_index = num_tasks > 0 ? num_tasks - 1 : 0;
+    }
+    if (changes > 0) {
+        char message[64];
+        snprintf(message, sizeof(message), "tasks.txt reloaded: %d change%s", changes, changes == 1 ? "" : "s");
+        show_notification(message, 2);
+        display_screen();
+    }
+}
+
+/* Turn tasks into target with the fewest events. Rows are matched by text
+ * (longest common subsequence); between matches, rows pair up as edits and
+ * the rest are removed or inserted. Returns the number of events. */
+int tasks_sync(const Task *target, int count) {
+    static short lcs[MAX_TASKS + 1][MAX_TASKS + 1];
+    int n = num_tasks;
+    for (int i = n; i >= 0; i--) {
+        for (int j = count; j >= 0; j--) {
+            if (i == n || j == count) {
+                lcs[i][j] = 0;
+            } else if (strcmp(tasks[i].task, target[j].task) == 0) {
+                lcs[i][j] = lcs[i + 1][j + 1] + 1;
+            } else {
+                lcs[i][j] = lcs[i + 1][j] > lcs[i][j + 1] ? lcs[i + 1][j] : lcs[i][j + 1];
+            }
         }
     }
     
-    // Check for commands with arguments
-    if (cmd_str[0] == 'a' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
-        cmd->type = CMD_ADD_TASK;
-        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
-        return 1;
-    } else if (cmd_str[0] == 't' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
-        cmd->type = CMD_SET_FOCUS;
-        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
-        return 1;
-    } else if (cmd_str[0] == 'd' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
-        cmd->type = CMD_MARK_DONE;
-        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
-        return 1;
-    } else if (cmd_str[0] == 'u' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
-        cmd->type = CMD_UNMARK;
-        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
-        return 1;
-    } else if (cmd_str[0] == 'r' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
-        cmd->type = CMD_REMOVE;
-        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
-        return 1;
+    // Snapshot of the old list: tasks[] changes as the events apply
+    static Task old[MAX_TASKS];
+    memcpy(old, tasks, n * sizeof(Task));
+    
+    int changes = 0;
+    int pos = 0;
+    int i = 0;
+    int j = 0;
+    while (i < n || j < count) {
+        if (i < n && j < count && strcmp(old[i].task, target[j].task) == 0 && lcs[i][j] == lcs[i + 1][j + 1] + 1) {
+            i++;
+            j++;
+        } else {
+            // Collect the gap up to the next matched pair
+            int gi = i;
+            int gj = j;
+            while (gi < n || gj < count) {
+                if (gi < n && gj < count && strcmp(old[gi].task, target[gj].task) == 0 &&
+                    lcs[gi][gj] == lcs[gi + 1][gj + 1] + 1) {
+                    break;
+                }
+                if (gj == count || (gi < n && lcs[gi + 1][gj] >= lcs[gi][gj + 1])) {
+                    gi++;
+                } else {
+                    gj++;
+                }
+            }
+            
+            int edits = gi - i < gj - j ? gi - i : gj - j;
+            for (int k = 0; k < edits; k++) {
+                state_emit(EV_TASK_EDIT, pos + k, target[j + k].task);
+                changes++;
+            }
+            for (int k = edits; k < gi - i; k++) {
+                state_emit(EV_TASK_REMOVE, pos + edits, "");
+                changes++;
+            }
+            for (int k = edits; k < gj - j; k++) {
+                if (pos + k == num_tasks) {
+                    state_emit(EV_TASK_ADD, 0, target[j + k].task);
+                } else {
+                    state_emit(EV_TASK_INSERT, pos + k, target[j + k].task);
+                }
+                changes++;
+            }
+            pos += gj - j;
+            i = gi;
+            j = gj;
+            continue;
+        }
+        pos++;
     }
     
-    // If no specific command matched, treat as quick add task
-    cmd->type = CMD_ADD_TASK;
-    safe_strncpy(cmd->argument, cmd_str, sizeof(cmd->argument));
-    return 1;
+    // Rows now line up with target; fix the checkboxes
+    for (int k = 0; k < count && k < num_tasks; k++) {
+        if (tasks[k].done != target[k].done) {
+            state_emit(target[k].done ? EV_TASK_DONE : EV_TASK_UNDONE, k, "");
+            changes++;
+        }
+    }
+    return changes;
 }
 
-int execute_command(const ParsedCommand *cmd) {
-    if (!cmd) {
-        return 0;
+/* Event-sourced state. events.log holds one line per change,
+ *   <seq> <wall time> <type> <index> [<text>]
+ * and is only ever appended to. tasks.txt, sessions.csv and meta are views
+ * kept up to date from it. snapshot.bin records the state as of some seq
+ * and where that seq ends in the log, so startup replays only the tail. */
+void state_emit(StateEventType type, int index, const char *text) {
+    state_lock();
+    
+    StateEvent ev;
+    ev.seq = state_seq + 1;
+    ev.at = (long long)wall_time();
+    ev.type = type;
+    ev.index = index;
+    safe_strncpy(ev.text, text, sizeof(ev.text));
+    
+    char line[MAX_INPUT_LEN + 96];
+    int len = state_format_event(&ev, line, sizeof(line));
+    if (event_batch_len + len > EVENT_BATCH_SIZE) {
+        state_write_batch();
     }
+    memcpy(event_batch + event_batch_len, line, len);
+    event_batch_len += len;
     
-    switch (cmd->type) {
-        case CMD_ADD_TASK:
-            if (strlen(cmd->argument) > 0) {
-                add_task(cmd->argument);
+    state_apply(&ev, 1);
+    events_since_snapshot++;
+}
+
+// ev as its events.log line; returns the length, newline included
+int state_format_event(const StateEvent *ev, char *line, int size) {
+    int len = snprintf(line, size, "%lld %lld %s %d%s%s\n", ev->seq, ev->at,
+                       state_event_names[ev->type], ev->index, ev->text[0] ? " " : "", ev->text);
+    if (len >= size) {
+        len = size - 1;
+        line[len - 1] = '\n';
+    }
+    return len;
+}
+
+// The only code that changes persistent state. Replay passes live = 0.
+void state_apply(const StateEvent *ev, int live) {
+    state_seq = ev->seq;
+    
+    // The feed names a changed task as it was before
+    int announce = live || state_catching_up;
+    char old_task[MAX_TASK_LEN];
+    int old_streak = streaks.streak_current;
+    old_task[0] = '\0';
+    if (announce && ev->type >= EV_TASK_DONE && ev->type <= EV_TASK_EDIT && ev->index >= 0 && ev->index < num_tasks) {
+        safe_strncpy(old_task, tasks[ev->index].task, MAX_TASK_LEN);
+    }
+    
+    switch (ev->type) {
+        case EV_TASK_ADD:
+            if (num_tasks < MAX_TASKS) {
+                safe_strncpy(tasks[num_tasks].task, ev->text, MAX_TASK_LEN);
+                tasks[num_tasks].done = 0;
+                num_tasks++;
             }
-            return 1;
+            break;
             
-        case CMD_SET_FOCUS:
-            if (strlen(cmd->argument) > 0) {
-                safe_strncpy(focus_task, cmd->argument, MAX_TASK_LEN);
-                show_notification("Focus task updated", 2);
+        case EV_TASK_DONE:
+        case EV_TASK_UNDONE:
+            if (ev->index >= 0 && ev->index < num_tasks) {
+                tasks[ev->index].done = ev->type == EV_TASK_DONE;
             }
-            return 1;
+            break;
             
-        case CMD_MARK_DONE: {
-            int task_num;
-            if (validate_task_number(cmd->argument, &task_num) && task_num > 0 && task_num <= num_tasks) {
-                mark_task_done(task_num - 1);
-                return 1;
+        case EV_TASK_REMOVE:
+            if (ev->index >= 0 && ev->index < num_tasks) {
+                // Shift all tasks after the removed task up by one
+                for (int i = ev->index; i < num_tasks - 1; i++) {
+                    tasks[i] = tasks[i + 1];
+                }
+                num_tasks--;
             }
-            show_notification("Invalid task number", 2);
-            return 0;
-        }
+            break;
             
-        case CMD_UNMARK: {
-            int task_num;
-            if (validate_task_number(cmd->argument, &task_num) && task_num > 0 && task_num <= num_tasks) {
-                unmark_task(task_num - 1);
-                return 1;
+        case EV_TASK_EDIT:
+            if (ev->index >= 0 && ev->index < num_tasks) {
+                safe_strncpy(tasks[ev->index].task, ev->text, MAX_TASK_LEN);
             }
-            show_notification("Invalid task number", 2);
-            return 0;
-        }
+            break;
             
-        case CMD_REMOVE: {
-            int task_num;
-            if (validate_task_number(cmd->argument, &task_num) && task_num > 0 && task_num <= num_tasks) {
-                remove_task(task_num - 1);
-                return 1;
+        case EV_TASK_INSERT:
+            if (num_tasks < MAX_TASKS && ev->index >= 0 && ev->index <= num_tasks) {
+                memmove(&tasks[ev->index + 1], &tasks[ev->index], (num_tasks - ev->index) * sizeof(Task));
+                safe_strncpy(tasks[ev->index].task, ev->text, MAX_TASK_LEN);
+                tasks[ev->index].done = 0;
+                num_tasks++;
             }
-            show_notification("Invalid task number", 2);
-            return 0;
-        }
-            
-        case CMD_START_FOCUS:
-            start_focus_session();
-            return 1;
+            break;
             
-        case CMD_START_BREAK:
-            start_break_session();
-            return 1;
+        case EV_FOCUS:
+            safe_strncpy(focus_task, ev->text, MAX_TASK_LEN);
+            break;
             
-        case CMD_STOP:
-            stop_session();
-            return 1;
+        case EV_SESSION_LOG: {
+            char date_part[DATE_STR_LEN];
+            char time_part[TIME_STR_LEN];
+            int duration;
+            char task_part[MAX_TASK_LEN];
+            if (parse_csv_line(ev->text, date_part, time_part, &duration, task_part)) {
+                update_streaks(date_part);
+                if (strcmp(date_part, day_stats.date) != 0) {
+                    safe_strncpy(day_stats.date, date_part, DATE_STR_LEN);
+                    day_stats.sessions = 0;
+                    day_stats.focus_seconds = 0;
+                }
+                day_stats.sessions++;
+                day_stats.focus_seconds += duration;
+            }
             
-        case CMD_SKIP:
-            skip_session();
-            return 1;
+            // sessions.csv already has the rows of replayed events
+            if (live) {
+                persist_append_row(PR_SESSION_ROW, ev->text);
+                metric_add(&metrics.sessions_logged, 1);
+            }
+            break;
+        }
             
-        case CMD_QUIT:
-            running = 0;
-            return 1;
+        case EV_DAY_SEAL:
+            safe_strncpy(sealed_day, ev->text, DATE_STR_LEN);
+            if (live) {
+                persist_append_row(PR_DAY_ROW, ev->text);
+            }
+            break;
             
-        case CMD_HELP:
-            display_screen();
-            return 1;
+        case EV_IMPORT: {
+            char last_day[DATE_STR_LEN];
+            char day[DATE_STR_LEN];
+            if (sscanf(ev->text, "%d %d %10s %10s %d %d", &streaks.streak_max, &streaks.streak_current,
+                       last_day, day, &day_stats.sessions, &day_stats.focus_seconds) == 6) {
+                safe_strncpy(last_session_day, strcmp(last_day, "-") == 0 ? "" : last_day, DATE_STR_LEN);
+                safe_strncpy(day_stats.date, strcmp(day, "-") == 0 ? "" : day, DATE_STR_LEN);
+                meta_dirty = 1;
+            }
+            break;
+        }
             
         default:
-            return 0;
+            // Session start/stop/skip are history only; a running session
+            // comes back from the checkpoint, not from replay
+            break;
+    }
+    
+    if (ev->type <= EV_TASK_INSERT) {
+        tasks_dirty = 1;
+    }
+    
+    // Attached clients repeat the change rather than receive the whole list;
+    // changes other instances made reach them the same way
+    if (announce) {
+        daemon_queue_event(ev);
+        feed_state_event(ev, old_task, old_streak);
     }
 }
 
-int parse_command(char *input) {
-    ParsedCommand cmd;
-    int result = parse_command_input(input, &cmd);
-    if (result) {
-        return execute_command(&cmd);
+int state_parse_event(char *line, StateEvent *ev) {
+    char name[32];
+    int used = 0;
+    if (sscanf(line, "%lld %lld %31s %d %n", &ev->seq, &ev->at, name, &ev->index, &used) != 4 || used == 0) {
+        return 0;
+    }
+    
+    for (int t = 0; t < EV_COUNT; t++) {
+        if (strcmp(name, state_event_names[t]) == 0) {
+            ev->type = (StateEventType)t;
+            char *text = line + used;
+            text[strcspn(text, "\n")] = '\0';
+            safe_strncpy(ev->text, text, sizeof(ev->text));
+            return 1;
+        }
     }
     return 0;
 }
 
-void log_session() {
-    time_t end_time = time(NULL);
-    int duration = (int)(end_time - session_start_time);
-    
-    // Get current date and time
-    struct tm *start_tm = localtime(&session_start_time);
-    if (start_tm == NULL) {
-        show_notification("Error getting session time", 2);
-        return;
+// Hand the pending batch and the views it changed to the writer thread,
+// which writes the batch with one write() and one fdatasync()
+void state_flush() {
+    // An outside edit that landed since the last look is merged before it can be overwritten
+    if (tasks_dirty || tasks_reload_deferred) {
+        tasks_reload();
     }
     
-    char date_str[DATE_STR_LEN];
-    char time_str[TIME_STR_LEN];
+    // Views and snapshots are written under the lock too, so they follow the shared order
+    if (tasks_dirty || meta_dirty || events_since_snapshot >= SNAPSHOT_EVERY) {
+        state_lock();
+    }
     
-    strftime(date_str, DATE_STR_LEN, "%Y-%m-%d", start_tm);
-    strftime(time_str, TIME_STR_LEN, "%H:%M", start_tm);
+    state_write_batch();
     
-    // Open sessions file for appending
-    FILE *fp = fopen(sessions_file, "a");
-    if (fp == NULL) {
-        show_notification("Error writing to sessions file", 2);
-        return;
+    if (tasks_dirty) {
+        save_tasks();
+        tasks_dirty = 0;
+    }
+    if (meta_dirty) {
+        save_meta();
+        meta_dirty = 0;
+    }
+    if (events_since_snapshot >= SNAPSHOT_EVERY) {
+        state_snapshot();
     }
     
-    fprintf(fp, "%s,%s,%d,\"%s\"\n", date_str, time_str, duration, focus_task);
-    
-    if (fclose(fp) != 0) {
-        show_notification("Error closing sessions file", 2);
+    // The writer drops the lock once all of the above is on disk
+    if (events_locked) {
+        persist_reserve(PR_UNLOCK, 0);
+        persist_commit(0);
+        events_locked = 0;
     }
+    persist_kick();
     
-    // Update streaks
-    update_streaks();
+    const char *error = __atomic_exchange_n(&persist_error, NULL, __ATOMIC_ACQUIRE);
+    if (error != NULL) {
+        show_notification(error, 2);
+    }
 }
 
-// Improved CSV parsing function
-int parse_csv_line(const char *line, char *date_part, char *time_part, int *duration, char *task_part) {
-    if (!line || !date_part || !time_part || !duration || !task_part) {
+/* Queue the pending batch for events.log and no more. It keeps the lock, so
+ * a change made of more events than fit in a batch, such as a large
+ * tasks.txt reload, stays one run in the log that nobody can come between. */
+void state_write_batch() {
+    if (event_batch_len > 0 && events_fd != -1) {
+        memcpy(persist_reserve(PR_EVENTS, event_batch_len), event_batch, event_batch_len);
+        persist_commit(event_batch_len);
+        events_log_size += event_batch_len;
+    }
+    event_batch_len = 0;
+}
+
+// Only called with an empty batch, so events_log_size is exactly where state_seq ends
+void state_snapshot() {
+    Snapshot *snap = persist_reserve(PR_SNAPSHOT, sizeof(Snapshot));
+    memset(snap, 0, sizeof(Snapshot));
+    memcpy(snap->magic, SNAPSHOT_MAGIC, sizeof(snap->magic));
+    snap->seq = state_seq;
+    snap->log_offset = events_log_size;
+    snap->num_tasks = num_tasks;
+    snap->streak_max = streaks.streak_max;
+    snap->streak_current = streaks.streak_current;
+    safe_strncpy(snap->last_session_day, last_session_day, sizeof(snap->last_session_day));
+    safe_strncpy(snap->focus_task, focus_task, sizeof(snap->focus_task));
+    memcpy(snap->tasks, tasks, sizeof(snap->tasks));
+    snap->day_stats = day_stats;
+    safe_strncpy(snap->sealed_day, sealed_day, sizeof(snap->sealed_day));
+    snap->checksum = fnv1a(snap, offsetof(Snapshot, checksum));
+    persist_commit(sizeof(Snapshot));
+    events_since_snapshot = 0;
+}
+
+// Load snapshot.bin and the log offset it ends at; 0 if missing or damaged
+int state_load_snapshot(long long *offset) {
+    Snapshot *snap = malloc(sizeof(Snapshot));
+    if (snap == NULL) {
         return 0;
     }
     
-    // Create a copy to work with
-    char line_copy[512];
-    safe_strncpy(line_copy, line, sizeof(line_copy));
-    
-    char *ptr = line_copy;
+    int ok = 0;
+    int fd = open(snapshot_file, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        ok = read(fd, snap, sizeof(Snapshot)) == (ssize_t)sizeof(Snapshot) &&
+             memcmp(snap->magic, SNAPSHOT_MAGIC, sizeof(snap->magic)) == 0 &&
+             snap->checksum == fnv1a(snap, offsetof(Snapshot, checksum)) &&
+             snap->num_tasks >= 0 && snap->num_tasks <= MAX_TASKS &&
+             snap->log_offset <= events_log_size;
+        close(fd);
+    }
     
-    // Extract date
-    char *field = ptr;
-    ptr = strchr(ptr, ',');
-    if (!ptr) return 0;
-    *ptr = '\0';
-    safe_strncpy(date_part, field, DATE_STR_LEN);
-    ptr++;
+    if (ok) {
+        state_seq = snap->seq;
+        *offset = snap->log_offset;
+        num_tasks = snap->num_tasks;
+        memcpy(tasks, snap->tasks, sizeof(tasks));
+        streaks.streak_max = snap->streak_max;
+        streaks.streak_current = snap->streak_current;
+        snap->last_session_day[DATE_STR_LEN - 1] = '\0';
+        safe_strncpy(last_session_day, snap->last_session_day, DATE_STR_LEN);
+        snap->focus_task[MAX_TASK_LEN - 1] = '\0';
+        safe_strncpy(focus_task, snap->focus_task, MAX_TASK_LEN);
+        day_stats = snap->day_stats;
+        day_stats.date[DATE_STR_LEN - 1] = '\0';
+        snap->sealed_day[DATE_STR_LEN - 1] = '\0';
+        safe_strncpy(sealed_day, snap->sealed_day, DATE_STR_LEN);
+    }
+    free(snap);
+    return ok;
+}
+
+// First run with an event log: take over the state the old files describe
+void state_bootstrap() {
+    // Another instance may have got there first; its events came in with the lock
+    state_lock();
+    if (state_seq > 0) {
+        state_flush();
+        return;
+    }
     
-    // Extract time
-    field = ptr;
-    ptr = strchr(ptr, ',');
-    if (!ptr) return 0;
-    *ptr = '\0';
-    safe_strncpy(time_part, field, TIME_STR_LEN);
-    ptr++;
+    static Task imported[MAX_TASKS];
+    int count = 0;
+    struct stat st;
+    uint32_t hash;
+    tasks_file_read(imported, &count, &st, &hash);
     
-    // Extract duration
-    field = ptr;
-    ptr = strchr(ptr, ',');
-    if (!ptr) return 0;
-    *ptr = '\0';
+    StreakData streak = {0, 0};
+    DayStats day = {"", 0, 0};
+    FILE *fp = fopen(meta_file, "r");
+    if (fp != NULL) {
+        char line[256];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (strncmp(line, "streak_max=", 11) == 0) {
+                streak.streak_max = atoi(line + 11);
+            } else if (strncmp(line, "streak_current=", 15) == 0) {
+                streak.streak_current = atoi(line + 15);
+            }
+        }
+        if (fclose(fp) != 0) {
+            LOG_WARN("Failed to close meta file");
+        }
+    }
+    
+    fp = fopen(sessions_file, "r");
+    if (fp != NULL) {
+        char line[512];
+        char date_part[DATE_STR_LEN];
+        char time_part[TIME_STR_LEN];
+        int duration;
+        char task_part[MAX_TASK_LEN];
+        
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (!parse_csv_line(line, date_part, time_part, &duration, task_part)) {
+                continue;
+            }
+            if (strcmp(date_part, day.date) > 0) {
+                safe_strncpy(day.date, date_part, DATE_STR_LEN);
+                day.sessions = 0;
+                day.focus_seconds = 0;
+            }
+            if (strcmp(date_part, day.date) == 0) {
+                day.sessions++;
+                day.focus_seconds += duration;
+            }
+        }
+        if (fclose(fp) != 0) {
+            LOG_WARN("Failed to close sessions file");
+        }
+    }
+    
+    // Into the log, so a replay from the start rebuilds it without the snapshot
+    for (int i = 0; i < count; i++) {
+        state_emit(EV_TASK_ADD, 0, imported[i].task);
+        if (imported[i].done) {
+            state_emit(EV_TASK_DONE, i, "");
+        }
+    }
+    char text[96];
+    snprintf(text, sizeof(text), "%d %d %s %s %d %d", streak.streak_max, streak.streak_current,
+             day.date[0] ? day.date : "-", day.date[0] ? day.date : "-", day.sessions, day.focus_seconds);
+    state_emit(EV_IMPORT, 0, text);
+    state_flush();
+}
+
+// Apply the complete lines from offset on; returns where they end
+long long state_replay(long long offset) {
+    FILE *fp = fopen(events_file, "r");
+    if (fp == NULL || fseeko(fp, offset, SEEK_SET) != 0) {
+        if (fp) {
+            fclose(fp);
+        }
+        return offset;
+    }
+    
+    char line[MAX_INPUT_LEN + 96];
+    long long good_end = offset;  // End of the last complete line
+    StateEvent ev;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            break;  // Torn final write
+        }
+        good_end += len;
+        if (state_parse_event(line, &ev) && ev.seq > state_seq) {
+            state_apply(&ev, 0);
+            events_since_snapshot++;
+        }
+    }
+    fclose(fp);
+    return good_end;
+}
+
+/* Several instances may share a data directory. Each event is appended
+ * under an exclusive flock on events.log, taken by the first event of a
+ * batch and released by the writer thread once the batch and the views are
+ * written; so each loop iteration locks at most once, for microseconds.
+ * A batch taken while the writer still holds the lock for the one before
+ * keeps it: nobody else can have appended in between.
+ * Taking it first applies whatever the others appended, so seq numbers,
+ * indexes, streaks and day totals always follow the one shared order.
+ * Nothing reads under the lock: the display, status bars and the inotify
+ * catch-up read only complete lines. */
+void state_lock() {
+    if (events_locked || events_fd == -1) {
+        return;
+    }
+    int refs = __atomic_load_n(&events_lock_refs, __ATOMIC_ACQUIRE);
+    for (;;) {
+        if (refs == -1) {
+            sched_yield();  // The writer is between its last batch and LOCK_UN
+            refs = __atomic_load_n(&events_lock_refs, __ATOMIC_ACQUIRE);
+        } else if (__atomic_compare_exchange_n(&events_lock_refs, &refs, refs + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    events_locked = 1;
+    if (refs > 0) {
+        return;
+    }
+    
+    if (flock(events_fd, LOCK_EX | LOCK_NB) == -1) {
+        events_lock_contended++;
+        if (flock(events_fd, LOCK_EX) == -1) {
+            LOG_WARN("Failed to lock the event log");
+            __atomic_store_n(&events_lock_refs, 0, __ATOMIC_RELEASE);
+            events_locked = 0;
+            return;
+        }
+    }
+    state_catch_up();
+}
+
+// Apply events other instances appended since we last read or wrote the log; 1 if any
+int state_catch_up() {
+    struct stat st;
+    if (events_fd == -1 || fstat(events_fd, &st) == -1 || st.st_size <= events_log_size) {
+        return 0;
+    }
+    
+    // Whoever wrote these events also wrote the views
+    int tasks_were_dirty = tasks_dirty;
+    int meta_was_dirty = meta_dirty;
+    long long seq = state_seq;
+    state_catching_up = 1;
+    long long end = state_replay(events_log_size);
+    state_catching_up = 0;
+    tasks_dirty = tasks_were_dirty;
+    meta_dirty = meta_was_dirty;
+    events_log_size = end;
+    
+    // Under the lock nobody is mid-write, so a partial line was torn by a crash
+    if (events_locked && end < st.st_size && ftruncate(events_fd, end) == -1) {
+        LOG_WARN("Failed to drop a torn event");
+    }
+    if (current_task_index >= num_tasks) {
+        current_task_index = num_tasks > 0 ? num_tasks - 1 : 0;
+    }
+    return state_seq != seq;
+}
+
+void state_load() {
+    events_fd = open(events_file, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (events_fd == -1) {
+        fprintf(stderr, "Error opening %s: %s\n", events_file, strerror(errno));
+        exit(1);
+    }
+    struct stat st;
+    events_log_size = fstat(events_fd, &st) == 0 ? st.st_size : 0;
+    persist_start();
+    
+    long long offset = 0;
+    if (!state_load_snapshot(&offset) && events_log_size == 0) {
+        state_bootstrap();
+        return;
+    }
+    long long end = state_replay(offset);
+    
+    // Drop a torn tail so the next append starts on a fresh line
+    if (end < events_log_size && ftruncate(events_fd, end) == 0) {
+        events_log_size = end;
+    }
+    
+    // Views may lag the log after a crash
+    tasks_dirty = 1;
+    meta_dirty = 1;
+    state_flush();
+}
+
+/* Persistence runs on a writer thread, so a slow disk or an NFS home stalls
+ * that thread instead of keys and the countdown. The main thread copies
+ * each write into persist_ring, a lock-free single-producer,
+ * single-consumer queue: reserve a record, fill it in, commit it by moving
+ * the tail. Nothing is allocated and no system call is made per change;
+ * state_flush() wakes the writer once per loop iteration through an
+ * eventfd. The writer carries the records out in order and moves the
+ * head. Only a full ring makes the main thread wait. */
+void *persist_reserve(PersistType type, uint32_t len) {
+    uint64_t size = (sizeof(PersistRecord) + len + 7) & ~7ULL;
+    uint64_t at = persist_tail % PERSIST_RING_SIZE;
+    uint64_t pad = at + size > PERSIST_RING_SIZE ? PERSIST_RING_SIZE - at : 0;
+    while (persist_tail + pad + size - __atomic_load_n(&persist_head, __ATOMIC_ACQUIRE) > PERSIST_RING_SIZE) {
+        persist_kick_pending = 1;
+        persist_drain();
+    }
+    
+    // A record never wraps; the space left at the end is skipped
+    if (pad > 0) {
+        PersistRecord *skip = (PersistRecord *)(persist_ring + at);
+        skip->type = PR_SKIP;
+        skip->len = pad - sizeof(PersistRecord);
+        at = 0;
+    }
+    persist_open = persist_tail + pad;
+    PersistRecord *rec = (PersistRecord *)(persist_ring + at);
+    rec->type = type;
+    rec->len = len;
+    return rec + 1;
+}
+
+// Publish the record persist_reserve() returned, trimmed to len bytes
+void persist_commit(uint32_t len) {
+    PersistRecord *rec = (PersistRecord *)(persist_ring + persist_open % PERSIST_RING_SIZE);
+    rec->len = len;
+    __atomic_store_n(&persist_tail, persist_open + ((sizeof(PersistRecord) + len + 7) & ~7ULL), __ATOMIC_RELEASE);
+    if (persist_running) {
+        persist_kick_pending = 1;
+    } else {
+        persist_consume();
+    }
+}
+
+// Queue one line for sessions.csv or days.csv
+void persist_append_row(PersistType type, const char *text) {
+    uint32_t len = strlen(text);
+    char *row = persist_reserve(type, len + 1);
+    memcpy(row, text, len);
+    row[len] = '\n';
+    persist_commit(len + 1);
+}
+
+// Wake the writer if anything was committed since it was last woken
+void persist_kick() {
+    if (!persist_kick_pending || !persist_running) {
+        return;
+    }
+    persist_kick_pending = 0;
+    uint64_t one = 1;
+    if (write(persist_wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        LOG_WARN("Failed to wake the writer thread");
+    }
+}
+
+// Wait until everything committed so far is written
+void persist_drain() {
+    persist_kick();
+    struct timespec pause = { 0, 200000 };
+    while (persist_running && __atomic_load_n(&persist_head, __ATOMIC_ACQUIRE) != persist_tail) {
+        nanosleep(&pause, NULL);
+    }
+}
+
+// Write every committed record; 1 once PR_STOP is reached
+int persist_consume() {
+    uint64_t head = __atomic_load_n(&persist_head, __ATOMIC_RELAXED);
+    uint64_t tail = __atomic_load_n(&persist_tail, __ATOMIC_ACQUIRE);
+    int stop = 0;
+    while (head != tail) {
+        const PersistRecord *rec = (const PersistRecord *)(persist_ring + head % PERSIST_RING_SIZE);
+        stop |= rec->type == PR_STOP;
+        persist_write((PersistType)rec->type, (const char *)(rec + 1), rec->len);
+        head += (sizeof(PersistRecord) + rec->len + 7) & ~7ULL;
+        __atomic_store_n(&persist_head, head, __ATOMIC_RELEASE);
+    }
+    return stop;
+}
+
+void persist_write(PersistType type, const char *data, uint32_t len) {
+    long long start = system_monotonic_ns();  // The simulated clock belongs to the main thread
+    switch (type) {
+        case PR_EVENTS:
+            if (write(events_fd, data, len) != (ssize_t)len || fdatasync(events_fd) == -1) {
+                persist_fail("Error writing event log");
+            }
+            break;
+            
+        case PR_UNLOCK:
+            persist_unlock();
+            return;
+            
+        case PR_SESSION_ROW:
+        case PR_DAY_ROW: {
+            FILE *fp = fopen(type == PR_SESSION_ROW ? sessions_file : days_file, "a");
+            if (fp == NULL || fwrite(data, 1, len, fp) != len) {
+                persist_fail(type == PR_SESSION_ROW ? "Error writing to sessions file" : "Error writing to days file");
+            }
+            if (fp != NULL && fclose(fp) != 0) {
+                persist_fail(type == PR_SESSION_ROW ? "Error closing sessions file" : "Error closing days file");
+            }
+            break;
+        }
+            
+        case PR_TASKS: {
+            // Write aside and rename, so readers see the old list or the new one, never part of it
+            char tmp_file[MAX_PATH_LEN + 4];
+            snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", tasks_file);
+            FILE *fp = fopen(tmp_file, "w");
+            if (fp == NULL) {
+                persist_fail("Failed to open tasks file for writing");
+            } else if (fwrite(data, 1, len, fp) != len) {
+                persist_fail("Failed to write tasks file");
+                fclose(fp);
+            } else if (fclose(fp) != 0 || rename(tmp_file, tasks_file) != 0) {
+                persist_fail("Failed to close tasks file");
+            }
+            
+            // tasks_reload() takes a file that looks like this for ours
+            struct stat st;
+            if (stat(tasks_file, &st) == 0) {
+                pthread_mutex_lock(&tasks_written_lock);
+                tasks_written_stat = st;
+                pthread_mutex_unlock(&tasks_written_lock);
+            }
+            __atomic_fetch_sub(&tasks_writes_pending, 1, __ATOMIC_RELEASE);
+            break;
+        }
+            
+        case PR_META: {
+            const StreakData *saved = (const StreakData *)data;
+            FILE *fp = fopen(meta_file, "w");
+            if (fp == NULL) {
+                persist_fail("Error writing to meta file");
+                break;
+            }
+            fprintf(fp, "streak_max=%d\nstreak_current=%d\n", saved->streak_max, saved->streak_current);
+            if (fclose(fp) != 0) {
+                persist_fail("Error closing meta file");
+            }
+            break;
+        }
+            
+        case PR_SNAPSHOT: {
+            // Write aside and rename, so a crash leaves either the old or the new snapshot
+            char tmp_file[MAX_PATH_LEN + 4];
+            snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", snapshot_file);
+            int fd = open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd != -1) {
+                int ok = write(fd, data, len) == (ssize_t)len && fdatasync(fd) == 0;
+                close(fd);
+                if (ok) {
+                    rename(tmp_file, snapshot_file);  // A failed snapshot only makes the next startup replay more
+                }
+            }
+            break;
+        }
+            
+        case PR_CHECKPOINT:
+            if (pwrite(checkpoint_fd, data, len, 0) != (ssize_t)len) {
+                persist_fail("Error writing session checkpoint");
+            }
+            break;
+            
+        case PR_METRICS: {
+            char tmp_file[MAX_PATH_LEN + 4];
+            snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", metrics_file);
+            FILE *fp = fopen(tmp_file, "w");
+            if (fp == NULL || fwrite(data, 1, len, fp) != len || fclose(fp) != 0 || rename(tmp_file, metrics_file) != 0) {
+                persist_fail("Error writing the metrics file");
+            }
+            return;  // Not one of our saves
+        }
+            
+        default:
+            return;
+    }
+    
+    metric_add(&metrics.saves, 1);
+    metric_add(&metrics.bytes_written, len);
+    metric_add(&metrics.fsyncs, type == PR_EVENTS || type == PR_SNAPSHOT);
+    histogram_observe(&metrics.save_latency, system_monotonic_ns() - start);
+}
+
+// For the main thread's next state_flush() to show
+void persist_fail(const char *message) {
+    __atomic_store_n(&persist_error, message, __ATOMIC_RELEASE);
+}
+
+// Drop this batch's hold on the events.log lock; the last one out unlocks
+void persist_unlock() {
+    int refs = __atomic_load_n(&events_lock_refs, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&events_lock_refs, &refs, refs == 1 ? -1 : refs - 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    }
+    if (refs == 1) {
+        flock(events_fd, LOCK_UN);
+        __atomic_store_n(&events_lock_refs, 0, __ATOMIC_RELEASE);
+    }
+}
+
+void *persist_writer(void *arg __attribute__((unused))) {
+    while (!persist_consume()) {
+        uint64_t wakeups;
+        if (read(persist_wake_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EINTR) {
+            LOG_ERROR("Failed to read the writer thread's eventfd");
+        }
+    }
+    return NULL;
+}
+
+// Without the thread every record is written as it is committed
+void persist_start() {
+    if (persist_running) {
+        return;
+    }
+    persist_wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (persist_wake_fd == -1 || pthread_create(&persist_thread, NULL, persist_writer, NULL) != 0) {
+        LOG_WARN("No writer thread; writing from the main thread");
+        if (persist_wake_fd != -1) {
+            close(persist_wake_fd);
+            persist_wake_fd = -1;
+        }
+        return;
+    }
+    persist_running = 1;
+}
+
+// Write everything still queued and end the thread; later writes are made directly
+void persist_stop() {
+    if (!persist_running) {
+        return;
+    }
+    persist_reserve(PR_STOP, 0);
+    persist_commit(0);
+    persist_kick();
+    pthread_join(persist_thread, NULL);
+    persist_running = 0;
+    close(persist_wake_fd);
+    persist_wake_fd = -1;
+}
+
+int validate_input(const char *input) {
+    if (input == NULL || strlen(input) == 0) {
+        return 0;  // Invalid input
+    }
+    
+    // Check for buffer overflow attempts
+    if (strlen(input) >= MAX_INPUT_LEN) {
+        return 0;  // Input too long
+    }
+    
+    return 1;  // Valid input
+}
+
+// Simplified command parsing with better structure
+typedef enum {
+    CMD_NONE,
+    CMD_ADD_TASK,
+    CMD_SET_FOCUS,
+    CMD_MARK_DONE,
+    CMD_UNMARK,
+    CMD_REMOVE,
+    CMD_START_FOCUS,
+    CMD_START_BREAK,
+    CMD_STOP,
+    CMD_SKIP,
+    CMD_QUIT,
+    CMD_HELP
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    char argument[MAX_INPUT_LEN];
+} ParsedCommand;
+
+int parse_command_input(const char *input, ParsedCommand *cmd) {
+    if (!validate_input(input) || !cmd) {
+        return 0;
+    }
+    
+    // Initialize command
+    cmd->type = CMD_NONE;
+    cmd->argument[0] = '\0';
+    
+    // Make a copy of input to work with
+    char cmd_copy[MAX_INPUT_LEN];
+    safe_strncpy(cmd_copy, input, sizeof(cmd_copy));
+    
+    // Remove trailing newline if present
+    char *newline = strchr(cmd_copy, '\n');
+    if (newline) *newline = '\0';
+    newline = strchr(cmd_copy, '\r');
+    if (newline) *newline = '\0';
+    
+    // Skip leading whitespace
+    char *cmd_str = cmd_copy;
+    while (*cmd_str == ' ' || *cmd_str == '\t') {
+        cmd_str++;
+    }
+    
+    if (*cmd_str == '\0') {
+        return 1;  // Empty command, valid but no action
+    }
+    
+    // Check for single character commands
+    if (strlen(cmd_str) == 1) {
+        switch (cmd_str[0]) {
+            case 'f':
+                cmd->type = CMD_START_FOCUS;
+                return 1;
+            case 'b':
+                cmd->type = CMD_START_BREAK;
+                return 1;
+            case 's':
+                cmd->type = CMD_STOP;
+                return 1;
+            case 'd':
+                cmd->type = CMD_SKIP;
+                return 1;
+            case 'q':
+                cmd->type = CMD_QUIT;
+                return 1;
+            case 'h':
+            case '?':
+                cmd->type = CMD_HELP;
+                return 1;
+        }
+    }
+    
+    // Check for commands with arguments
+    if (cmd_str[0] == 'a' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
+        cmd->type = CMD_ADD_TASK;
+        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
+        return 1;
+    } else if (cmd_str[0] == 't' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
+        cmd->type = CMD_SET_FOCUS;
+        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
+        return 1;
+    } else if (cmd_str[0] == 'd' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
+        cmd->type = CMD_MARK_DONE;
+        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
+        return 1;
+    } else if (cmd_str[0] == 'u' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
+        cmd->type = CMD_UNMARK;
+        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
+        return 1;
+    } else if (cmd_str[0] == 'r' && (cmd_str[1] == ' ' || cmd_str[1] == '\t')) {
+        cmd->type = CMD_REMOVE;
+        safe_strncpy(cmd->argument, cmd_str + 2, sizeof(cmd->argument));
+        return 1;
+    }
+    
+    // If no specific command matched, treat as quick add task
+    cmd->type = CMD_ADD_TASK;
+    safe_strncpy(cmd->argument, cmd_str, sizeof(cmd->argument));
+    return 1;
+}
+
+int execute_command(const ParsedCommand *cmd) {
+    if (!cmd) {
+        return 0;
+    }
+    
+    switch (cmd->type) {
+        case CMD_ADD_TASK:
+            if (strlen(cmd->argument) > 0) {
+                add_task(cmd->argument);
+            }
+            return 1;
+            
+        case CMD_SET_FOCUS:
+            if (strlen(cmd->argument) > 0) {
+                state_emit(EV_FOCUS, 0, cmd->argument);
+                show_notification("Focus task updated", 2);
+            }
+            return 1;
+            
+        case CMD_MARK_DONE: {
+            int task_num;
+            if (validate_task_number(cmd->argument, &task_num) && task_num > 0 && task_num <= num_tasks) {
+                mark_task_done(task_num - 1);
+                return 1;
+            }
+            show_notification("Invalid task number", 2);
+            return 0;
+        }
+            
+        case CMD_UNMARK: {
+            int task_num;
+            if (validate_task_number(cmd->argument, &task_num) && task_num > 0 && task_num <= num_tasks) {
+                unmark_task(task_num - 1);
+                return 1;
+            }
+            show_notification("Invalid task number", 2);
+            return 0;
+        }
+            
+        case CMD_REMOVE: {
+            int task_num;
+            if (validate_task_number(cmd->argument, &task_num) && task_num > 0 && task_num <= num_tasks) {
+                remove_task(task_num - 1);
+                return 1;
+            }
+            show_notification("Invalid task number", 2);
+            return 0;
+        }
+            
+        case CMD_START_FOCUS:
+            start_focus_session();
+            return 1;
+            
+        case CMD_START_BREAK:
+            start_break_session();
+            return 1;
+            
+        case CMD_STOP:
+            stop_session();
+            return 1;
+            
+        case CMD_SKIP:
+            skip_session();
+            return 1;
+            
+        case CMD_QUIT:
+            // Quitting a client never stops the daemon behind it
+            if (listen_fd == -1) {
+                running = 0;
+            }
+            return 1;
+            
+        case CMD_HELP:
+            display_screen();
+            return 1;
+            
+        default:
+            return 0;
+    }
+}
+
+int parse_command(char *input) {
+    ParsedCommand cmd;
+    int result = parse_command_input(input, &cmd);
+    if (result) {
+        return execute_command(&cmd);
+    }
+    return 0;
+}
+
+void log_session() {
+    int duration = session_active_seconds();
+    
+    // Get current date and time
+    struct tm *start_tm = localtime(&session_start_time);
+    if (start_tm == NULL) {
+        show_notification("Error getting session time", 2);
+        return;
+    }
+    
+    char date_str[DATE_STR_LEN];
+    char time_str[TIME_STR_LEN];
+    
+    strftime(date_str, DATE_STR_LEN, "%Y-%m-%d", start_tm);
+    strftime(time_str, TIME_STR_LEN, "%H:%M", start_tm);
+    
+    // Applying the event appends the row to sessions.csv and updates the streak
+    char row[MAX_INPUT_LEN];
+    snprintf(row, sizeof(row), "%s,%s,%d,\"%s\"", date_str, time_str, duration, focus_task);
+    state_emit(EV_SESSION_LOG, 0, row);
+    sessions_logged++;
+    seal_finished_day();
+}
+
+// Improved CSV parsing function
+int parse_csv_line(const char *line, char *date_part, char *time_part, int *duration, char *task_part) {
+    if (!line || !date_part || !time_part || !duration || !task_part) {
+        return 0;
+    }
+    
+    // Create a copy to work with
+    char line_copy[512];
+    safe_strncpy(line_copy, line, sizeof(line_copy));
+    
+    char *ptr = line_copy;
+    
+    // Extract date
+    char *field = ptr;
+    ptr = strchr(ptr, ',');
+    if (!ptr) return 0;
+    *ptr = '\0';
+    safe_strncpy(date_part, field, DATE_STR_LEN);
+    ptr++;
+    
+    // Extract time
+    field = ptr;
+    ptr = strchr(ptr, ',');
+    if (!ptr) return 0;
+    *ptr = '\0';
+    safe_strncpy(time_part, field, TIME_STR_LEN);
+    ptr++;
+    
+    // Extract duration
+    field = ptr;
+    ptr = strchr(ptr, ',');
+    if (!ptr) return 0;
+    *ptr = '\0';
     *duration = atoi(field);
     ptr++;
     
-    // Extract task (inside quotes)
-    if (*ptr == '"') {
-        ptr++; // Skip opening quote
-        field = ptr;
-        ptr = strchr(ptr, '"');
-        if (!ptr) return 0;
-        *ptr = '\0';
-        safe_strncpy(task_part, field, MAX_TASK_LEN);
-        return 1;
+    // Extract task (inside quotes)
+    if (*ptr == '"') {
+        ptr++; // Skip opening quote
+        field = ptr;
+        ptr = strchr(ptr, '"');
+        if (!ptr) return 0;
+        *ptr = '\0';
+        safe_strncpy(task_part, field, MAX_TASK_LEN);
+        return 1;
+    }
+    
+    return 0;
+}
+
+// Improved date validation
+int is_date_valid(const char *date_str) {
+    if (!date_str || strlen(date_str) != 10) {
+        return 0;
+    }
+    
+    // Check format YYYY-MM-DD
+    if (date_str[4] != '-' || date_str[7] != '-') {
+        return 0;
+    }
+    
+    // Check if all other characters are digits
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 7) continue;
+        
+        if (date_str[i] < '0' || date_str[i] > '9') {
+            return 0;
+        }
+    }
+    
+    // Basic range checking
+    int year = atoi(date_str);
+    int month = atoi(date_str + 5);
+    int day = atoi(date_str + 8);
+    
+    if (year < 2000 || year > 2100) return 0;
+    if (month < 1 || month > 12) return 0;
+    if (day < 1 || day > 31) return 0;
+    
+    return 1;
+}
+
+// Count a session logged on day (YYYY-MM-DD) toward the streak
+void update_streaks(const char *day) {
+    if (streak_count_day(&streaks, last_session_day, day)) {
+        meta_dirty = 1;
+    }
+}
+
+// Count day toward streak, whose newest counted day is last_day; 1 if it changed
+int streak_count_day(StreakData *streak, char *last_day, const char *day) {
+    if (strcmp(day, last_day) <= 0) {
+        // Already counted today, or a late session from before the newest counted day
+        return 0;
+    }
+    
+    // Step back one calendar day; day - 86400 s misses it after a 23-hour DST day
+    char yesterday_str[DATE_STR_LEN];
+    calendar_yesterday(day, yesterday_str);
+    if (yesterday_str[0] == '\0') {
+        return 0;
+    }
+    
+    if (strcmp(last_day, yesterday_str) == 0) {
+        streak->streak_current++;
+        if (streak->streak_current > streak->streak_max) {
+            streak->streak_max = streak->streak_current;
+        }
+    } else {
+        // No session yesterday means we break the streak
+        streak->streak_current = 1;
+        if (streak->streak_max < 1) {
+            streak->streak_max = 1;  // The very first day
+        }
+    }
+    
+    safe_strncpy(last_day, day, DATE_STR_LEN);
+    return 1;
+}
+
+void save_meta() {
+    *(StreakData *)persist_reserve(PR_META, sizeof(StreakData)) = streaks;
+    persist_commit(sizeof(StreakData));
+}
+
+// Both read only the day_rollover() cache, or a daemon client's copy of
+// the daemon's figures; no date or file work per frame
+int get_today_sessions_count() {
+    if (daemon_fd != -1) {
+        return daemon_today;
+    }
+    return strcmp(day_stats.date, today_date) == 0 ? day_stats.sessions : 0;
+}
+
+// A streak stays alive until a whole day passes without a session
+int get_current_streak() {
+    if (daemon_fd != -1) {
+        return daemon_streak;
+    }
+    if (strcmp(last_session_day, today_date) == 0 || strcmp(last_session_day, yesterday_date) == 0) {
+        return streaks.streak_current;
+    }
+    return 0;
+}
+
+// Seal the rollup of the newest day with sessions once it is over
+void seal_finished_day() {
+    // Another instance may have sealed it already
+    state_lock();
+    
+    if (day_stats.date[0] == '\0' || strcmp(day_stats.date, today_date) >= 0 ||
+        strcmp(day_stats.date, sealed_day) <= 0) {
+        return;
+    }
+    
+    char rollup[64];
+    snprintf(rollup, sizeof(rollup), "%s,%d,%d", day_stats.date, day_stats.sessions, day_stats.focus_seconds);
+    state_emit(EV_DAY_SEAL, day_stats.sessions, rollup);
+}
+
+// Set today_date and yesterday_date from the wall clock
+void update_day_dates() {
+    time_t now = wall_time();
+    struct tm tm = *localtime(&now);
+    strftime(today_date, DATE_STR_LEN, "%Y-%m-%d", &tm);
+    
+    // Calendar arithmetic, so 23- and 25-hour DST days land on the right date
+    tm.tm_mday--;
+    tm.tm_hour = 12;
+    tm.tm_isdst = -1;
+    mktime(&tm);
+    strftime(yesterday_date, DATE_STR_LEN, "%Y-%m-%d", &tm);
+}
+
+// Move the cached dates to the current local day and seal the one before
+void day_rollover() {
+    update_day_dates();
+    
+    // A focus session running across midnight is logged under the day it
+    // started; log_session() seals that day once it has the session
+    int waiting = 0;
+    if (session_state == SESSION_FOCUS) {
+        char started[DATE_STR_LEN];
+        strftime(started, DATE_STR_LEN, "%Y-%m-%d", localtime(&session_start_time));
+        waiting = strcmp(started, today_date) < 0;
+    }
+    if (!waiting) {
+        seal_finished_day();
+    }
+    schedule_midnight();
+}
+
+void schedule_midnight() {
+    time_t now = wall_time();
+    struct tm tm = *localtime(&now);
+    tm.tm_mday++;
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    time_t midnight = mktime(&tm);
+    
+    timer_start(&timer_wheel, &midnight_timer, monotonic_ns() + (long long)(midnight - now) * NS_PER_SEC);
+}
+
+// If the wall clock lagged CLOCK_MONOTONIC this fires a little early; day_rollover() then just re-arms
+void on_midnight(Timer *timer __attribute__((unused)), void *ctx __attribute__((unused))) {
+    day_rollover();
+    frame_begin();
+    display_screen();
+    frame_end();
+}
+
+int draw_history_view(WINDOW *win, int first, int rows) {
+    int text_width = getmaxx(win) - 24;
+    int count = 0;
+    
+    FILE *fp = fopen(sessions_file, "r");
+    if (fp != NULL) {
+        char line[512];
+        char date_part[DATE_STR_LEN];
+        char time_part[TIME_STR_LEN];
+        int duration;
+        char task_part[MAX_TASK_LEN];
+        
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (!parse_csv_line(line, date_part, time_part, &duration, task_part) ||
+                strcmp(date_part, today_date) != 0) {
+                continue;
+            }
+            
+            if (count >= first && count < first + rows) {
+                // End time through mktime() so a session spanning a DST change reads right
+                struct tm session_tm = {0};
+                sscanf(date_part, "%d-%d-%d", &session_tm.tm_year, &session_tm.tm_mon, &session_tm.tm_mday);
+                sscanf(time_part, "%d:%d", &session_tm.tm_hour, &session_tm.tm_min);
+                session_tm.tm_year -= 1900;
+                session_tm.tm_mon -= 1;
+                session_tm.tm_isdst = -1;
+                time_t session_end = mktime(&session_tm) + duration;
+                
+                char end_time_str[TIME_STR_LEN];
+                strftime(end_time_str, TIME_STR_LEN, "%H:%M", localtime(&session_end));
+                mvwprintw(win, 1 + count - first, 2, "%s-%s  %3d min  %.*s", time_part, end_time_str,
+                          duration / 60, text_width > 0 ? text_width : 0,
+                          strlen(task_part) > 0 ? task_part : "???");
+            }
+            count++;
+        }
+        if (fclose(fp) != 0) {
+            LOG_WARN("Failed to close sessions file");
+        }
+    }
+    
+    if (count == 0) {
+        mvwprintw(win, 1, 2, "(No sessions today)");
+    }
+    return count;
+}
+
+int draw_help_view(WINDOW *win, int first, int rows) {
+    if (help_pad == NULL) {
+        build_help_pad();
+        if (help_pad == NULL) {
+            return 0;
+        }
+    }
+    
+    int shown = help_pad_lines - first < rows ? help_pad_lines - first : rows;
+    int cols = getmaxx(win) - 2 < getmaxx(help_pad) ? getmaxx(win) - 2 : getmaxx(help_pad);
+    if (shown > 0 && cols > 0) {
+        copywin(help_pad, win, first, 0, 1, 1, shown, cols, FALSE);
+    }
+    return help_pad_lines;
+}
+
+void view_push(const char *title, int (*draw)(WINDOW *win, int first, int rows), int width) {
+    if (headless || view_count == MAX_VIEWS) {
+        return;
+    }
+    
+    View *view = &views[view_count++];
+    view->title = title;
+    view->draw = draw;
+    view->width = width;
+    view->scroll = 0;
+    view->lines = 0;
+    view_open_window(view);
+    
+    frame_begin();
+    view_render(view);
+    frame_end();
+}
+
+// Views sit between the timer box and the input line, centred
+void view_open_window(View *view) {
+    int height, width;
+    getmaxyx(stdscr, height, width);
+    int w = view->width < width - 4 ? view->width : width - 4;
+    view->win = newwin(height - VIEW_TOP - 2, w, VIEW_TOP, (width - w) / 2);
+}
+
+void view_render(View *view) {
+    if (view->win == NULL) {
+        return;
+    }
+    
+    werase(view->win);
+    draw_border(view->win);
+    mvwprintw(view->win, 0, 2, " %s ", view->title);
+    
+    int rows = getmaxy(view->win) - 2;
+    view->lines = view->draw(view->win, view->scroll, rows);
+    mvwprintw(view->win, rows + 1, 2, " Esc: close%s ", view->lines > rows ? "  j/k: scroll" : "");
+    wnoutrefresh(view->win);
+}
+
+// Close the top view and restage what it covered from the windows' own contents
+void view_pop() {
+    if (view_count == 0) {
+        return;
+    }
+    
+    View *view = &views[--view_count];
+    if (view->win) {
+        delwin(view->win);
+        view->win = NULL;
+    }
+    
+    frame_begin();
+    touchwin(stdscr);
+    wnoutrefresh(stdscr);
+    WINDOW *base[] = { timer_win, tasks_win, input_win };
+    for (size_t i = 0; i < sizeof(base) / sizeof(base[0]); i++) {
+        if (base[i]) {
+            touchwin(base[i]);
+            wnoutrefresh(base[i]);
+        }
+    }
+    if (show_help) {
+        display_help();
+    }
+    frame_end();  // Restages the views still open
+}
+
+void view_handle_key(int ch) {
+    View *view = &views[view_count - 1];
+    int rows = view->win ? getmaxy(view->win) - 2 : 0;
+    
+    if (ch == 27 || ch == 'q' || ch == '\n' || ch == '\r') {
+        view_pop();
+    } else if ((ch == 'j' || ch == KEY_DOWN) && view->scroll + rows < view->lines) {
+        view->scroll++;
+    } else if ((ch == 'k' || ch == KEY_UP) && view->scroll > 0) {
+        view->scroll--;
+    } else if (ch == '?' && view->draw != draw_help_view) {
+        key_show_help();
+        return;
+    } else {
+        return;
+    }
+    
+    if (view_count > 0 && view == &views[view_count - 1]) {
+        frame_begin();
+        view_render(view);
+        frame_end();
+    }
+}
+
+// Called by frame_end() so timer ticks and redraws underneath never cover a view
+void views_stage() {
+    for (int i = 0; i < view_count; i++) {
+        if (views[i].win) {
+            touchwin(views[i].win);
+            wnoutrefresh(views[i].win);
+        }
+    }
+}
+
+void views_resize() {
+    for (int i = 0; i < view_count; i++) {
+        if (views[i].win) {
+            delwin(views[i].win);
+        }
+        view_open_window(&views[i]);
+        view_render(&views[i]);
+    }
+}
+
+// Render the help text once into an off-screen pad
+void build_help_pad() {
+    int sections = sizeof(help_section_titles) / sizeof(help_section_titles[0]);
+    int bindings = sizeof(key_bindings) / sizeof(key_bindings[0]);
+    int tips = sizeof(help_tips) / sizeof(help_tips[0]);
+    int width = HELP_WIDTH - 2;
+    
+    // Title, blank, each section plus a blank, tips heading and lines
+    help_pad_lines = 2 + sections * 2 + bindings + 1 + tips;
+    help_pad = newpad(help_pad_lines, width);
+    if (help_pad == NULL) {
+        help_pad_lines = 0;
+        return;
+    }
+    
+    mvwprintw(help_pad, 0, (width - 15) / 2, "FOCUSFORGE HELP");
+    
+    int line = 2;
+    for (int section = 0; section < sections; section++) {
+        mvwprintw(help_pad, line++, 1, "%s", help_section_titles[section]);
+        for (int i = 0; i < bindings; i++) {
+            if (key_bindings[i].section == section) {
+                mvwprintw(help_pad, line++, 1, "%-6s - %s", key_bindings[i].label, key_bindings[i].help);
+            }
+        }
+        line++;
+    }
+    
+    mvwprintw(help_pad, line++, 1, "TIPS:");
+    for (int i = 0; i < tips; i++) {
+        mvwprintw(help_pad, line++, 1, "%s", help_tips[i]);
+    }
+}
+
+void display_help() {
+    if (help_win == NULL) {
+        return;
+    }
+    
+    if (help_pad == NULL) {
+        build_help_pad();
+        if (help_pad == NULL) {
+            return;
+        }
+    }
+    
+    // Frame is drawn once in setup_windows(); only restage it here
+    touchwin(help_win);
+    wnoutrefresh(help_win);
+    
+    int top, left, rows, cols;
+    getbegyx(help_win, top, left);
+    getmaxyx(help_win, rows, cols);
+    int visible = rows - 2 < help_pad_lines ? rows - 2 : help_pad_lines;
+    if (visible <= 0) {
+        return;
+    }
+    
+    touchwin(help_pad);
+    pnoutrefresh(help_pad, 0, 0, top + 1, left + 1, top + visible, left + cols - 2);
+}
+
+void initialize_directories() {
+    const char *home = getenv("HOME");
+    if (home == NULL && data_dir == NULL) {
+        fprintf(stderr, "Error: HOME environment variable not set\n");
+        exit(1);
+    }
+    
+    int ret = data_dir ? snprintf(focusforge_dir, sizeof(focusforge_dir), "%s", data_dir)
+                       : snprintf(focusforge_dir, sizeof(focusforge_dir), "%s/.focusforge", home);
+    if (ret < 0 || ret >= (int)sizeof(focusforge_dir)) {
+        fprintf(stderr, "Error: Path too long for focusforge directory\n");
+        exit(1);
+    }
+    
+    ret = snprintf(tasks_file, sizeof(tasks_file), "%s/tasks.txt", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(tasks_file)) {
+        fprintf(stderr, "Error: Path too long for tasks file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(sessions_file, sizeof(sessions_file), "%s/sessions.csv", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(sessions_file)) {
+        fprintf(stderr, "Error: Path too long for sessions file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(meta_file, sizeof(meta_file), "%s/meta", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(meta_file)) {
+        fprintf(stderr, "Error: Path too long for meta file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(settings_file, sizeof(settings_file), "%s/settings", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(settings_file)) {
+        fprintf(stderr, "Error: Path too long for settings file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(checkpoint_file, sizeof(checkpoint_file), "%s/session.ckpt", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(checkpoint_file)) {
+        fprintf(stderr, "Error: Path too long for checkpoint file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(events_file, sizeof(events_file), "%s/events.log", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(events_file)) {
+        fprintf(stderr, "Error: Path too long for events file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(snapshot_file, sizeof(snapshot_file), "%s/snapshot.bin", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(snapshot_file)) {
+        fprintf(stderr, "Error: Path too long for snapshot file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(days_file, sizeof(days_file), "%s/days.csv", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(days_file)) {
+        fprintf(stderr, "Error: Path too long for days file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(status_file, sizeof(status_file), "%s/status", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(status_file)) {
+        fprintf(stderr, "Error: Path too long for status file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(socket_file, sizeof(socket_file), "%s/focusforge.sock", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(socket_file)) {
+        fprintf(stderr, "Error: Path too long for socket file\n");
+        exit(1);
+    }
+    
+    ret = snprintf(feed_file, sizeof(feed_file), "%s/feed.sock", focusforge_dir);
+    if (ret < 0 || ret >= (int)sizeof(feed_file)) {
+        fprintf(stderr, "Error: Path too long for feed socket\n");
+        exit(1);
+    }
+    
+    // Create focusforge directory if it doesn't exist
+    struct stat st = {0};
+    if (stat(focusforge_dir, &st) == -1) {
+        if (mkdir(focusforge_dir, 0755) == -1) {
+            if (errno != EEXIST) {
+                fprintf(stderr, "Error creating directory %s: %s\n", focusforge_dir, strerror(errno));
+                exit(1);
+            }
+        }
+    }
+    
+    // Create tasks.txt if it doesn't exist
+    FILE *fp = fopen(tasks_file, "a");
+    if (fp) {
+        if (fclose(fp) != 0) {
+            LOG_WARN("Failed to close tasks file");
+        }
+    } else {
+        LOG_WARN("Failed to create tasks file");
+    }
+    
+    // Create sessions.csv if it doesn't exist
+    fp = fopen(sessions_file, "a");
+    if (fp) {
+        if (fclose(fp) != 0) {
+            LOG_WARN("Failed to create sessions file");
+        }
+    } else {
+        LOG_WARN("Failed to create sessions file");
+    }
+    
+    // Create meta file if it doesn't exist with default values
+    fp = fopen(meta_file, "r");
+    if (!fp) {
+        fp = fopen(meta_file, "w");
+        if (fp) {
+            fprintf(fp, "streak_max=0\nstreak_current=0\n");
+            if (fclose(fp) != 0) {
+                LOG_WARN("Failed to close meta file");
+            }
+        } else {
+            LOG_WARN("Failed to create meta file");
+        }
+    } else {
+        if (fclose(fp) != 0) {
+            LOG_WARN("Failed to close meta file");
+        }
+    }
+}
+
+void free_resources() {
+    // Free any allocated resources
+    destroy_windows();
+}
+
+void cleanup_and_exit(int sig) {
+    // Save any pending data; a running session stays resumable from the checkpoint
+    state_flush();
+    save_settings();
+    write_checkpoint();
+    persist_stop();
+    status_close();
+    feed_close();
+    
+    // Free resources
+    free_resources();
+    
+    // The socket goes with the daemon, so clients start standalone again
+    if (listen_fd != -1) {
+        unlink(socket_file);
+    }
+    
+    // End ncurses mode
+    if (!headless) {
+        endwin();
+    }
+    if (daemon_lost) {
+        fprintf(stderr, "The FocusForge daemon has stopped\n");
+    }
+    dump_frame_stats();
+    dump_render_stats();
+    
+    // Exit with the signal number
+    exit(sig);
+}
+
+/* Event loop: every wakeup source is an fd registered with epoll. */
+void event_loop_init(const sigset_t *signals) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        endwin();
+        perror("epoll_create1");
+        exit(1);
+    }
+    
+    wakeup_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    signal_fd = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (wakeup_timer_fd == -1 || signal_fd == -1) {
+        endwin();
+        perror("timerfd/signalfd");
+        exit(1);
+    }
+    
+    // The daemon has no terminal to read keys from
+    if ((!headless && event_add(STDIN_FILENO, EPOLLIN, on_stdin_ready, NULL) == NULL) ||
+        event_add(wakeup_timer_fd, EPOLLIN, on_wakeup_timer, NULL) == NULL ||
+        event_add(signal_fd, EPOLLIN, on_signal, NULL) == NULL) {
+        endwin();
+        perror("epoll_ctl");
+        exit(1);
+    }
+}
+
+EventSource *event_add(int fd, uint32_t events, EventHandler handler, void *ctx) {
+    EventSource *src = malloc(sizeof(EventSource));
+    if (src == NULL) {
+        return NULL;
+    }
+    
+    src->fd = fd;
+    src->handler = handler;
+    src->ctx = ctx;
+    
+    struct epoll_event ev = { .events = events, .data.ptr = src };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        free(src);
+        return NULL;
+    }
+    
+    src->next = event_sources;
+    event_sources = src;
+    return src;
+}
+
+void event_modify(EventSource *src, uint32_t events) {
+    if (src == NULL || src->fd < 0) {
+        return;
+    }
+    
+    struct epoll_event ev = { .events = events, .data.ptr = src };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, src->fd, &ev) == -1) {
+        LOG_ERROR("Failed to change watched events");
+    }
+}
+
+// Safe to call from a handler; the source is freed after the current batch
+void event_remove(EventSource *src) {
+    if (src == NULL || src->fd < 0) {
+        return;
+    }
+    
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, src->fd, NULL);
+    src->fd = -1;
+    event_sources_dead = 1;
+}
+
+// Note a return from epoll_wait(), keeping the last WAKEUP_SAMPLES of them
+void record_wakeup(long long now_ns) {
+    wakeup_times_ns[wakeups_total % WAKEUP_SAMPLES] = now_ns;
+    wakeups_total++;
+}
+
+// Wakeups during the last minute, the figure idle mode should keep at zero
+int wakeups_last_minute() {
+    long long since = monotonic_ns() - 60 * NS_PER_SEC;
+    int kept = wakeups_total < WAKEUP_SAMPLES ? (int)wakeups_total : WAKEUP_SAMPLES;
+    int count = 0;
+    for (int i = 0; i < kept; i++) {
+        if (wakeup_times_ns[i] >= since) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Block until at least one source is ready and dispatch everything ready
+void event_loop_wait() {
+    struct epoll_event ready[16];
+    int count = epoll_wait(epoll_fd, ready, 16, -1);
+    if (count == -1) {
+        if (errno != EINTR) {
+            LOG_ERROR("epoll_wait failed");
+            running = 0;
+        }
+        return;
+    }
+    
+    record_wakeup(monotonic_ns());
+    
+    for (int i = 0; i < count; i++) {
+        EventSource *src = ready[i].data.ptr;
+        if (src->fd >= 0) {
+            src->handler(src->fd, ready[i].events, src->ctx);
+        }
+    }
+    
+    if (event_sources_dead) {
+        EventSource **link = &event_sources;
+        while (*link) {
+            EventSource *src = *link;
+            if (src->fd < 0) {
+                *link = src->next;
+                free(src);
+            } else {
+                link = &src->next;
+            }
+        }
+        event_sources_dead = 0;
+    }
+}
+
+// Point the timerfd at the wheel's next expiry. With no session,
+// notification or deferred redraw the wheel is empty, the timer is disarmed
+// and the process sleeps until a key, signal or other fd wakes it.
+void arm_wakeup_timer() {
+    long long now = monotonic_ns();
+    long long wake = wheel_next_expiry_ns(&timer_wheel);
+    if (wake < 0) {
+        wake = 0;
+    } else if (wake <= now) {
+        wake = now + 1;  // Zero would disarm the timer
+    }
+    
+    struct itimerspec spec = {
+        .it_interval = { 0, 0 },
+        .it_value = { wake / NS_PER_SEC, wake % NS_PER_SEC },
+    };
+    if (timerfd_settime(wakeup_timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) == -1) {
+        LOG_ERROR("Failed to arm wakeup timer");
+    }
+}
+
+void on_stdin_ready(int fd __attribute__((unused)), uint32_t events __attribute__((unused)),
+                    void *ctx __attribute__((unused))) {
+    // Drain everything ncurses can decode; nodelay() makes getch() return ERR when empty
+    int ch;
+    while (running && (ch = getch()) != ERR) {
+        frame_key_received();
+        frame_begin();
+        handle_key_input(ch);
+        frame_end();
+    }
+}
+
+void on_wakeup_timer(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    // run_timer() advances the wheel after every wakeup; just acknowledge it
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        LOG_WARN("Failed to read wakeup timer");
+    }
+}
+
+void on_signal(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    struct signalfd_siginfo info;
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGWINCH) {
+            if (!headless) {
+                frame_begin();
+                handle_resize();
+                frame_end();
+            }
+        } else {
+            running = 0;
+        }
+    }
+}
+
+/* Hierarchical timing wheel. A timer sits at the level of the highest 6-bit
+ * digit in which its due tick differs from the wheel's current tick, in the
+ * slot named by its own digit there. Insert and cancel are O(1); a timer is
+ * moved down at most WHEEL_LEVELS - 1 times before it fires. Because every
+ * occupied slot lies ahead of the current tick, the occupancy bitmaps give
+ * the next interesting tick directly and idle stretches are skipped. Timers
+ * past the top level's window wait on an overflow list until it rolls over. */
+void timer_init(Timer *timer, const char *name, TimerCallback callback, void *ctx) {
+    memset(timer, 0, sizeof(*timer));
+    timer->name = name;
+    timer->callback = callback;
+    timer->ctx = ctx;
+    timer->level = -1;
+}
+
+int timer_pending(const Timer *timer) {
+    return timer->level >= 0;
+}
+
+void wheel_init(TimerWheel *wheel, long long now_ns) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now_ns / WHEEL_TICK_NS;
+}
+
+Timer **wheel_list(TimerWheel *wheel, int level, int slot) {
+    if (level == WHEEL_DUE) {
+        return &wheel->due;
+    }
+    return level == WHEEL_LEVELS ? &wheel->overflow : &wheel->slots[level][slot];
+}
+
+void wheel_place(TimerWheel *wheel, Timer *timer) {
+    long long at = timer->expires < wheel->now ? wheel->now : timer->expires;
+    
+    int level = 0;
+    if (at != wheel->now) {
+        level = (63 - __builtin_clzll((unsigned long long)(at ^ wheel->now))) / WHEEL_SLOT_BITS;
+        if (level > WHEEL_LEVELS) {
+            level = WHEEL_LEVELS;
+        }
+    }
+    int slot = level == WHEEL_LEVELS ? 0 : (int)((at >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1));
+    
+    Timer **head = wheel_list(wheel, level, slot);
+    timer->level = level;
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = *head;
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    *head = timer;
+    if (level < WHEEL_LEVELS) {
+        wheel->occupied[level] |= 1ULL << slot;
+    }
+    wheel->count++;
+}
+
+void timer_cancel(TimerWheel *wheel, Timer *timer) {
+    if (!timer_pending(timer)) {
+        return;
+    }
+    
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *wheel_list(wheel, timer->level, timer->slot) = timer->next;
+        if (timer->next == NULL && timer->level < WHEEL_LEVELS) {
+            wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+        }
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    
+    timer->level = -1;
+    timer->prev = timer->next = NULL;
+    wheel->count--;
+}
+
+// (Re)arm a timer; it fires on the first wheel_advance() at or after expires_ns
+void timer_start(TimerWheel *wheel, Timer *timer, long long expires_ns) {
+    timer_cancel(wheel, timer);
+    timer->expires = (expires_ns + WHEEL_TICK_NS - 1) / WHEEL_TICK_NS;
+    wheel_place(wheel, timer);
+}
+
+// Next tick at which a slot must fire or cascade, -1 if the wheel is empty
+long long wheel_next_tick(const TimerWheel *wheel, int *level) {
+    long long next = -1;
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+        if (wheel->occupied[l] == 0) {
+            continue;
+        }
+        
+        int shift = l * WHEEL_SLOT_BITS;
+        long long base = (wheel->now >> (shift + WHEEL_SLOT_BITS)) << (shift + WHEEL_SLOT_BITS);
+        long long tick = base | ((long long)__builtin_ctzll(wheel->occupied[l]) << shift);
+        if (next < 0 || tick < next) {
+            next = tick;
+            *level = l;
+        }
+    }
+    
+    // Overflow timers are re-placed once the top level's window rolls over
+    if (wheel->overflow && next < 0) {
+        int span = WHEEL_LEVELS * WHEEL_SLOT_BITS;
+        next = ((wheel->now >> span) + 1) << span;
+        *level = WHEEL_LEVELS;
+    }
+    return next;
+}
+
+long long wheel_next_expiry_ns(const TimerWheel *wheel) {
+    int level;
+    long long tick = wheel_next_tick(wheel, &level);
+    return tick < 0 ? -1 : tick * WHEEL_TICK_NS;
+}
+
+// Fire every timer due by now_ns; callbacks may start or cancel any timer
+int wheel_advance(TimerWheel *wheel, long long now_ns) {
+    long long target = now_ns / WHEEL_TICK_NS;
+    int fired = 0;
+    int level;
+    long long tick;
+    
+    while ((tick = wheel_next_tick(wheel, &level)) >= 0 && tick <= target) {
+        wheel->now = tick;
+        int slot = level == WHEEL_LEVELS ? 0 : (int)((tick >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1));
+        
+        // Take the slot off first: an overflow timer still a window or more
+        // away goes straight back on the overflow list, for the next pass.
+        // Callbacks may still cancel what is left through wheel->due
+        Timer **head = wheel_list(wheel, level, slot);
+        wheel->due = *head;
+        *head = NULL;
+        if (level < WHEEL_LEVELS) {
+            wheel->occupied[level] &= ~(1ULL << slot);
+        }
+        for (Timer *t = wheel->due; t != NULL; t = t->next) {
+            t->level = WHEEL_DUE;
+            t->slot = 0;
+        }
+        
+        Timer *timer;
+        while ((timer = wheel->due) != NULL) {
+            timer_cancel(wheel, timer);
+            if (level == 0 && timer->expires <= wheel->now) {
+                timer->callback(timer, timer->ctx);
+                fired++;
+            } else {
+                wheel_place(wheel, timer);  // Cascade to a finer level
+            }
+        }
+    }
+    
+    if (target > wheel->now) {
+        wheel->now = target;
+    }
+    return fired;
+}
+
+void bench_timer_wheel_fire(Timer *timer __attribute__((unused)), void *ctx) {
+    (*(long *)ctx)++;
+}
+
+/* Schedule 100k timers spread over a day, cancel a tenth, then run the
+ * wheel to the end in 1 s steps and report the cost per operation. */
+void bench_timer_wheel() {
+    const int count = 100000;
+    Timer *bench_timers = malloc(count * sizeof(Timer));
+    if (bench_timers == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return;
+    }
+    
+    TimerWheel wheel;
+    long fired = 0;
+    long long start = 1000 * NS_PER_SEC;
+    wheel_init(&wheel, start);
+    srand(1);
+    
+    long long t0 = monotonic_ns();
+    for (int i = 0; i < count; i++) {
+        timer_init(&bench_timers[i], "bench", bench_timer_wheel_fire, &fired);
+        long long offset = ((long long)rand() * 1000 + rand() % 1000) % (86400LL * 1000);
+        timer_start(&wheel, &bench_timers[i], start + offset * 1000000LL);
+    }
+    long long t1 = monotonic_ns();
+    for (int i = 0; i < count; i += 10) {
+        timer_cancel(&wheel, &bench_timers[i]);
+    }
+    long long t2 = monotonic_ns();
+    for (long long now = start; now <= start + 86400 * NS_PER_SEC; now += NS_PER_SEC) {
+        wheel_advance(&wheel, now);
+    }
+    long long t3 = monotonic_ns();
+    
+    printf("insert %.1f ns/timer, cancel %.1f ns/timer, advance+fire %.1f ns/timer\n",
+           (double)(t1 - t0) / count, (double)(t2 - t1) / (count / 10),
+           fired > 0 ? (double)(t3 - t2) / fired : 0.0);
+    printf("fired %ld of %d, %d left pending\n", fired, count - count / 10, wheel.count);
+    free(bench_timers);
+}
+
+// Keep phase_timer in step with session_state and session_deadline_ns
+void schedule_phase() {
+    if (session_state == SESSION_INACTIVE) {
+        timer_cancel(&timer_wheel, &phase_timer);
+        timer_cancel(&timer_wheel, &tick_timer);
+        timer_cancel(&timer_wheel, &checkpoint_timer);
+    } else {
+        timer_start(&timer_wheel, &phase_timer, session_deadline_ns);
+        if (checkpoint_fd != -1) {
+            timer_start(&timer_wheel, &checkpoint_timer, monotonic_ns() + CHECKPOINT_INTERVAL_NS);
+        }
+    }
+    
+    // Every phase change is checkpointed at once, including the change to inactive
+    write_checkpoint();
+    feed_phase();
+}
+
+void on_phase_expired(Timer *timer __attribute__((unused)), void *ctx __attribute__((unused))) {
+    // The break is measured from the exact expiry, not from when we noticed
+    if (session_state == SESSION_FOCUS) {
+        log_session();
+        session_state = SESSION_BREAK;
+        session_deadline_ns += BREAK_DURATION * NS_PER_SEC;
+        show_notification("Focus session completed! Break started.", 3);
+    } else if (session_state == SESSION_BREAK) {
+        session_state = SESSION_INACTIVE;
+        timer_seconds = FOCUS_DURATION;
+        show_notification("Break completed! Ready for next focus session.", 3);
+    }
+    schedule_phase();
+}
+
+void on_tick(Timer *timer __attribute__((unused)), void *ctx __attribute__((unused))) {
+    // Nothing to do: run_timer() recomputes the countdown on every wakeup
+}
+
+void on_notification_expired(Timer *timer __attribute__((unused)), void *ctx __attribute__((unused))) {
+    // The screen underneath needs repainting once the notification is gone
+    if (notification_win) {
+        delwin(notification_win);
+        notification_win = NULL;
+        frame_begin();
+        display_screen();
+        frame_end();
+    }
+}
+
+void on_redraw_due(Timer *timer __attribute__((unused)), void *ctx __attribute__((unused))) {
+    frame_begin();
+    display_screen();
+    frame_end();
+}
+
+void timers_init(long long now_ns) {
+    wheel_init(&timer_wheel, now_ns);
+    timer_init(&phase_timer, "phase", on_phase_expired, NULL);
+    timer_init(&tick_timer, "tick", on_tick, NULL);
+    timer_init(&notification_timer, "notification", on_notification_expired, NULL);
+    timer_init(&redraw_timer, "redraw", on_redraw_due, NULL);
+    timer_init(&checkpoint_timer, "checkpoint", on_checkpoint_due, NULL);
+    timer_init(&midnight_timer, "midnight", on_midnight, NULL);
+}
+
+uint32_t fnv1a(const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t checkpoint_checksum(const Checkpoint *ckpt) {
+    return fnv1a(ckpt, offsetof(Checkpoint, checksum));
+}
+
+// Overwrite the slot with the current session; no open, close or fsync per write
+void write_checkpoint() {
+    if (checkpoint_fd == -1) {
+        return;
+    }
+    
+    Checkpoint *ckpt = persist_reserve(PR_CHECKPOINT, sizeof(Checkpoint));
+    memset(ckpt, 0, sizeof(Checkpoint));
+    memcpy(ckpt->magic, CHECKPOINT_MAGIC, sizeof(ckpt->magic));
+    ckpt->state = session_state;
+    if (session_state != SESSION_INACTIVE) {
+        long long now = monotonic_ns();
+        ckpt->start_time = session_start_time;
+        ckpt->active_ns = session_active_ns();
+        ckpt->remaining_ns = session_deadline_ns > now ? session_deadline_ns - now : 0;
+        safe_strncpy(ckpt->focus_task, focus_task, sizeof(ckpt->focus_task));
+    }
+    ckpt->written_at = wall_time();
+    ckpt->checksum = checkpoint_checksum(ckpt);
+    persist_commit(sizeof(Checkpoint));
+}
+
+void on_checkpoint_due(Timer *timer, void *ctx __attribute__((unused))) {
+    write_checkpoint();
+    if (session_state != SESSION_INACTIVE) {
+        timer_start(&timer_wheel, timer, monotonic_ns() + CHECKPOINT_INTERVAL_NS);
+    }
+}
+
+/* Runs before initscr(): a session left running by a crash, a closed
+ * terminal or a quit is offered for resuming, or for logging as it stood. */
+void offer_resume() {
+    checkpoint_fd = open(checkpoint_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (checkpoint_fd == -1) {
+        LOG_WARN("Cannot open session checkpoint; sessions will not survive a crash");
+        return;
+    }
+    
+    Checkpoint ckpt;
+    if (pread(checkpoint_fd, &ckpt, sizeof(ckpt), 0) != (ssize_t)sizeof(ckpt) ||
+        memcmp(ckpt.magic, CHECKPOINT_MAGIC, sizeof(ckpt.magic)) != 0 ||
+        ckpt.checksum != checkpoint_checksum(&ckpt) ||
+        (ckpt.state != SESSION_FOCUS && ckpt.state != SESSION_BREAK)) {
+        return;
+    }
+    ckpt.focus_task[MAX_TASK_LEN - 1] = '\0';
+    
+    char started[32];
+    time_t start = (time_t)ckpt.start_time;
+    strftime(started, sizeof(started), "%Y-%m-%d %H:%M", localtime(&start));
+    int done = (int)(ckpt.active_ns / NS_PER_SEC);
+    int left = (int)((ckpt.remaining_ns + NS_PER_SEC - 1) / NS_PER_SEC);
+    
+    int focus = ckpt.state == SESSION_FOCUS;
+    printf("Unfinished %s session \"%s\" from %s: %d:%02d done, %d:%02d left.\n",
+           focus ? "focus" : "break", ckpt.focus_task, started, done / 60, done % 60, left / 60, left % 60);
+    printf(focus ? "[r]esume, [l]og as is, or [d]iscard? [r] " : "[r]esume or [d]iscard? [r] ");
+    fflush(stdout);
+    
+    char answer[16] = "";
+    if (fgets(answer, sizeof(answer), stdin) == NULL) {
+        answer[0] = 'r';  // Keep the session rather than lose it unasked
+    }
+    
+    if (answer[0] == 'd' || answer[0] == 'D' || (!focus && (answer[0] == 'l' || answer[0] == 'L'))) {
+        write_checkpoint();  // Inactive: clears the slot
+        return;
+    }
+    
+    // Carry on from the checkpoint as if the process had never stopped
+    long long now = monotonic_ns();
+    session_state = ckpt.state;
+    session_start_time = (time_t)ckpt.start_time;
+    session_start_mono_ns = now - ckpt.active_ns;
+    session_counted_gap_ns = 0;
+    session_deadline_ns = now + ckpt.remaining_ns;
+    timer_seconds = remaining_seconds(session_deadline_ns, now);
+    safe_strncpy(focus_task, ckpt.focus_task, MAX_TASK_LEN);
+    
+    if (answer[0] == 'l' || answer[0] == 'L') {
+        log_session();
+        session_state = SESSION_INACTIVE;
+        timer_seconds = FOCUS_DURATION;
+    }
+    schedule_phase();
+}
+
+/* status is rewritten in place by the process that owns the state and read
+ * through a shared mapping, so a status bar polling it costs no syscalls.
+ * The writer makes seq odd, updates the fields and makes it even again; a
+ * reader copies the page and retries if seq was odd or moved meanwhile.
+ * Readers never block the writer, which never waits for them. */
+void status_open() {
+    status_fd = open(status_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (status_fd == -1) {
+        LOG_WARN("Cannot open status page");
+        return;
+    }
+    
+    status_publish();
+}
+
+// Map the page for writing unless another instance already writes it; the
+// seqlock needs a single writer. A later status_publish() tries again, so the
+// next instance takes over when the writer exits.
+int status_claim() {
+    if (flock(status_fd, LOCK_EX | LOCK_NB) == -1) {
+        return 0;
+    }
+    
+    if (ftruncate(status_fd, sizeof(StatusPage)) == 0) {
+        void *map = mmap(NULL, sizeof(StatusPage), PROT_READ | PROT_WRITE, MAP_SHARED, status_fd, 0);
+        if (map != MAP_FAILED) {
+            status_page = map;
+        }
+    }
+    if (status_page == NULL) {
+        LOG_WARN("Cannot map status page");
+        close(status_fd);
+        status_fd = -1;
+        return 0;
+    }
+    
+    // A writer that died mid-update left seq odd; start from the next even value
+    status_page->seq = (status_page->seq + 1) & ~1u;
+    memcpy(status_page->magic, STATUS_MAGIC, sizeof(status_page->magic));
+    return 1;
+}
+
+void status_write(const StatusPage *next) {
+    uint32_t seq = status_page->seq;
+    __atomic_store_n(&status_page->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((char *)status_page + offsetof(StatusPage, pid), (const char *)next + offsetof(StatusPage, pid),
+           sizeof(StatusPage) - offsetof(StatusPage, pid));
+    __atomic_store_n(&status_page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Bring the page up to date; a no-op, and no seq bump, when nothing changed
+void status_publish() {
+    if (status_page == NULL && (status_fd == -1 || !status_claim())) {
+        return;
+    }
+    
+    // The page's writer serves the feed and metrics too, once the event loop is up
+    if (!feed_tried && epoll_fd != -1) {
+        feed_tried = 1;
+        feed_open();
+    }
+    if (!metrics_tried && epoll_fd != -1) {
+        metrics_tried = 1;
+        metrics_open();
+    }
+    
+    StatusPage next;
+    memset(&next, 0, sizeof(next));
+    next.pid = getpid();
+    next.state = session_state;
+    next.today_sessions = get_today_sessions_count();
+    next.streak = get_current_streak();
+    next.deadline_ns = session_state != SESSION_INACTIVE ? session_deadline_ns : 0;
+    safe_strncpy(next.date, today_date, sizeof(next.date));
+    safe_strncpy(next.focus_task, focus_task, sizeof(next.focus_task));
+    
+    // Only this process writes the page, so comparing against it needs no seqlock
+    if (memcmp((char *)&next + offsetof(StatusPage, pid), (char *)status_page + offsetof(StatusPage, pid),
+               sizeof(StatusPage) - offsetof(StatusPage, pid)) != 0) {
+        status_write(&next);
+    }
+}
+
+// Leave the last state on the page but mark it as no longer kept current
+void status_close() {
+    if (status_page == NULL) {
+        return;
+    }
+    
+    StatusPage next = *status_page;
+    next.pid = 0;
+    status_write(&next);
+    munmap(status_page, sizeof(StatusPage));
+    status_page = NULL;
+    close(status_fd);  // Lets another instance take over
+    status_fd = -1;
+}
+
+// Consistent copy of page into out; 0 if the writer stayed mid-update throughout
+int status_read(const StatusPage *page, StatusPage *out) {
+    for (int attempt = 0; attempt < STATUS_READ_ATTEMPTS; attempt++) {
+        uint32_t before = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            // The writer may be preempted mid-update; let it finish
+            if (attempt % 64 == 63) {
+                sched_yield();
+            }
+            continue;
+        }
+        memcpy(out, page, sizeof(StatusPage));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == before) {
+            return memcmp(out->magic, STATUS_MAGIC, sizeof(out->magic)) == 0;
+        }
+    }
+    return 0;
+}
+
+/* Read a shared page as fast as possible while a forked writer rewrites it
+ * continuously. Every write keeps the numeric fields equal, so a torn read
+ * would show up as a mismatch. */
+void bench_status_page() {
+    StatusPage *page = mmap(NULL, sizeof(StatusPage), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+    memset(page, 0, sizeof(StatusPage));
+    memcpy(page->magic, STATUS_MAGIC, sizeof(page->magic));
+    
+    pid_t writer = fork();
+    if (writer == -1) {
+        perror("fork");
+        return;
+    }
+    if (writer == 0) {
+        status_page = page;
+        StatusPage next = *page;
+        for (int32_t i = 1; getppid() != 1; i++) {
+            next.pid = next.state = next.today_sessions = next.streak = i;
+            next.deadline_ns = i;
+            snprintf(next.focus_task, sizeof(next.focus_task), "task %d", i);
+            status_write(&next);
+        }
+        _exit(0);
+    }
+    
+    const long reads = 10000000;
+    long failed = 0;
+    long torn = 0;
+    StatusPage copy;
+    long long t0 = monotonic_ns();
+    for (long i = 0; i < reads; i++) {
+        if (!status_read(page, &copy)) {
+            failed++;
+        } else if (copy.state != copy.streak || copy.deadline_ns != copy.pid || atoi(copy.focus_task + 5) != copy.pid) {
+            torn++;
+        }
+    }
+    long long t1 = monotonic_ns();
+    uint32_t writes = page->seq / 2;
+    
+    kill(writer, SIGKILL);
+    waitpid(writer, NULL, 0);
+    printf("%ld reads in %.3f s (%.1f ns each) against %u concurrent writes\n",
+           reads, (t1 - t0) / 1e9, (double)(t1 - t0) / reads, writes);
+    printf("%ld gave up mid-update, %ld torn\n", failed, torn);
+    munmap(page, sizeof(StatusPage));
+}
+
+void run_timer() {
+    suspend_offset_ns = boottime_ns() - monotonic_ns();
+    
+    // Main loop: settle state, paint, then sleep until the next event
+    while (running) {
+        // Reconcile any suspend since the last wakeup before reading the timer;
+        // a daemon client leaves that to the daemon
+        if (daemon_fd == -1) {
+            check_suspend_gap();
+        }
+        
+        // Fire phase expiry, notification expiry and deferred redraws
+        wheel_advance(&timer_wheel, monotonic_ns());
+        
+        // Remaining time is derived from the deadline, never counted down
+        if (session_state != SESSION_INACTIVE) {
+            timer_seconds = remaining_seconds(session_deadline_ns, monotonic_ns());
+        }
+        
+        // Update display; only the timer changes on a plain tick
+        frame_begin();
+        update_timer_display();
+        frame_end();
+        
+        // Wake exactly when the displayed second next changes
+        if (session_state != SESSION_INACTIVE && !headless) {
+            timer_start(&timer_wheel, &tick_timer, next_tick_ns(session_deadline_ns, monotonic_ns()));
+        }
+        
+        // Everything this wakeup changed reaches disk with one fdatasync(),
+        // then the daemon's clients
+        state_flush();
+        daemon_publish();
+        status_publish();
+        
+        if (running) {
+            arm_wakeup_timer();
+            event_loop_wait();
+        }
+    }
+}
+
+/* --daemon keeps the timer, tasks and session log in one long-lived process
+ * and serves them over ~/.focusforge/focusforge.sock. A TUI started while
+ * it runs is only a client: closing it leaves the session running.
+ *
+ * The protocol is newline-terminated text. Client to daemon:
+ *   cmd <command>          Any command-line input, as typed: "a Write docs", "d 2", "f"
+ *   shutdown               Stop the daemon
+ * Daemon to client, the full state on connect, then after every change only
+ * the lines for what changed, each batch closed by sync:
+ *   state <phase> <ms left>            Phase or deadline
+ *   stats <streak> <today's sessions> <date>
+ *   focus <text>
+ *   clear                  Empty the task list; a full state follows with
+ *   task <done> <text>     one of these per task
+ *   add <text>             Task changes, as the events that made them;
+ *   done <index>           indexes count from 0
+ *   undone <index>
+ *   remove <index>
+ *   edit <index> <text>
+ *   insert <index> <text>
+ *   sync                   End of the update
+ * and at any time:
+ *   notify <seconds> <text> */
+int daemon_address(struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(socket_file) >= sizeof(addr->sun_path)) {
+        return 0;
+    }
+    safe_strncpy(addr->sun_path, socket_file, sizeof(addr->sun_path));
+    return 1;
+}
+
+// Connection to a running daemon, or -1 if there is none
+int daemon_connect() {
+    struct sockaddr_un addr;
+    if (!daemon_address(&addr)) {
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd != -1 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Bind socket_file and listen with room for backlog pending connections; -1 if taken or failed
+int daemon_listen(int backlog) {
+    struct sockaddr_un addr;
+    if (!daemon_address(&addr)) {
+        fprintf(stderr, "Error: Path too long for socket %s\n", socket_file);
+        return -1;
+    }
+    
+    int probe = daemon_connect();
+    if (probe != -1) {
+        close(probe);
+        fprintf(stderr, "A FocusForge daemon is already running on %s\n", socket_file);
+        return -1;
+    }
+    unlink(socket_file);  // Left by a daemon that did not exit cleanly
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    
+    // Only the owner may connect, whatever the umask: clients can change state
+    mode_t old_mask = umask(077);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (bound == -1 || listen(fd, backlog) == -1) {
+        fprintf(stderr, "Error listening on %s: %s\n", socket_file, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Detach from the terminal and serve clients until SIGTERM or "shutdown"
+void run_daemon(const sigset_t *signals) {
+    listen_fd = daemon_listen(MAX_CLIENTS);
+    if (listen_fd == -1) {
+        exit(1);
+    }
+    
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid > 0) {
+        printf("FocusForge daemon started (pid %d) on %s\n", (int)pid, socket_file);
+        exit(0);
+    }
+    setsid();
+    
+    // No terminal from here on; warnings go to daemon.log
+    char log_file[MAX_PATH_LEN + 16];
+    snprintf(log_file, sizeof(log_file), "%s/daemon.log", focusforge_dir);
+    int null_fd = open("/dev/null", O_RDWR);
+    int log_fd = open(log_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (null_fd != -1) {
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(log_fd != -1 ? log_fd : null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+    if (log_fd != -1) {
+        close(log_fd);
+    }
+    
+    headless = 1;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    
+    state_load();
+    timers_init(monotonic_ns());
+    offer_resume();  // stdin is /dev/null, so an unfinished session is resumed
+    day_rollover();
+    status_open();
+    
+    event_loop_init(signals);
+    data_watch_start();
+    if (event_add(listen_fd, EPOLLIN, on_listen_ready, NULL) == NULL) {
+        LOG_ERROR("Failed to watch the daemon socket");
+        cleanup_and_exit(1);
+    }
+    
+    run_timer();
+    cleanup_and_exit(0);
+}
+
+void on_listen_ready(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd == -1) {
+        return;
+    }
+    
+    DaemonClient *client = NULL;
+    for (int i = 0; i < MAX_CLIENTS && client == NULL; i++) {
+        if (clients[i].fd == -1) {
+            client = &clients[i];
+        }
+    }
+    if (client == NULL) {
+        close(client_fd);
+        return;
+    }
+    
+    client->src = event_add(client_fd, EPOLLIN, on_client_ready, client);
+    if (client->src == NULL) {
+        close(client_fd);
+        return;
+    }
+    client->fd = client_fd;
+    client->len = 0;
+    client->hung_up = 0;
+    
+    // Bring the others up to date first, so every client matches `published`
+    // from here and the next diff suits them all
+    daemon_publish();
+    int len = daemon_format_state(daemon_out, sizeof(daemon_out));
+    client_send(client, daemon_out, len);
+}
+
+void on_client_ready(int fd, uint32_t events __attribute__((unused)), void *ctx) {
+    DaemonClient *client = ctx;
+    ssize_t got = read(fd, client->buf + client->len, sizeof(client->buf) - 1 - client->len);
+    if (got <= 0) {
+        if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+            client_close(client);
+        }
+        return;
+    }
+    client->len += got;
+    
+    char *start = client->buf;
+    char *newline;
+    while (client->fd != -1 && (newline = memchr(start, '\n', client->buf + client->len - start)) != NULL) {
+        *newline = '\0';
+        daemon_handle_request(client, start);
+        start = newline + 1;
+    }
+    if (client->fd == -1) {
+        return;
+    }
+    
+    client->len -= start - client->buf;
+    memmove(client->buf, start, client->len);
+    if (client->len == (int)sizeof(client->buf) - 1) {
+        client_close(client);  // No request is this long
+    }
+}
+
+// A client that cannot take a whole message now is dropped, never waited for
+void client_send(DaemonClient *client, const char *data, int len) {
+    if (client->fd == -1 || client->hung_up) {
+        return;
+    }
+    if (send(client->fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+        // A client that wrote "shutdown" and left may not have been read yet:
+        // on_client_ready() handles what it sent, then closes it at EOF
+        if (errno == EPIPE || errno == ECONNRESET) {
+            client->hung_up = 1;
+        } else {
+            client_close(client);
+        }
+    }
+}
+
+void client_close(DaemonClient *client) {
+    event_remove(client->src);
+    close(client->fd);
+    client->fd = -1;
+    client->src = NULL;
+}
+
+void daemon_handle_request(DaemonClient *client, char *line) {
+    if (strncmp(line, "cmd ", 4) == 0) {
+        // Its notifications go back to this client only
+        requesting_client = client;
+        parse_command(line + 4);
+        requesting_client = NULL;
+    } else if (strcmp(line, "shutdown") == 0) {
+        running = 0;
+    } else {
+        client_send(client, "notify 2 Unknown request\n", 25);
+    }
+}
+
+int daemon_format_state(char *buf, int size) {
+    long long now = monotonic_ns();
+    long long left_ms = 0;
+    if (session_state != SESSION_INACTIVE && session_deadline_ns > now) {
+        left_ms = (session_deadline_ns - now) / 1000000;
+    }
+    
+    int len = snprintf(buf, size, "state %d %lld\nstats %d %d %s\nfocus %s\nclear\n", session_state, left_ms,
+                       get_current_streak(), get_today_sessions_count(), today_date, focus_task);
+    for (int i = 0; i < num_tasks && len < size; i++) {
+        len += snprintf(buf + len, size - len, "task %d %s\n", tasks[i].done, tasks[i].task);
+    }
+    if (len < size) {
+        len += snprintf(buf + len, size - len, "sync\n");
+    }
+    return len < size ? len : size - 1;
+}
+
+// Queue one line of the next diff; past the buffer, clients get the full state instead
+void daemon_queue(const char *fmt, ...) {
+    if (listen_fd == -1 || client_diff_len < 0) {
+        return;
+    }
+    
+    va_list args;
+    va_start(args, fmt);
+    int room = sizeof(client_diff) - client_diff_len;
+    int len = vsnprintf(client_diff + client_diff_len, room, fmt, args);
+    va_end(args);
+    client_diff_len = len >= 0 && len < room ? client_diff_len + len : -1;
+}
+
+// A live event as the diff line that repeats it on a client's copy
+void daemon_queue_event(const StateEvent *ev) {
+    switch (ev->type) {
+        case EV_TASK_ADD: daemon_queue("add %s\n", ev->text); break;
+        case EV_TASK_DONE: daemon_queue("done %d\n", ev->index); break;
+        case EV_TASK_UNDONE: daemon_queue("undone %d\n", ev->index); break;
+        case EV_TASK_REMOVE: daemon_queue("remove %d\n", ev->index); break;
+        case EV_TASK_EDIT: daemon_queue("edit %d %s\n", ev->index, ev->text); break;
+        case EV_TASK_INSERT: daemon_queue("insert %d %s\n", ev->index, ev->text); break;
+        case EV_FOCUS: daemon_queue("focus %s\n", ev->text); break;
+        default: break;
+    }
+}
+
+/* Once per loop iteration, send every client what changed since the last
+ * call: the queued task and focus lines, plus the phase and the day's
+ * figures if they moved. The countdown itself is never sent; clients run
+ * it from the deadline. */
+void daemon_publish() {
+    if (listen_fd == -1) {
+        return;
+    }
+    
+    long long deadline = session_state != SESSION_INACTIVE ? session_deadline_ns : 0;
+    if (session_state != published.state || deadline != published.deadline_ns) {
+        long long now = monotonic_ns();
+        daemon_queue("state %d %lld\n", session_state, deadline > now ? (deadline - now) / 1000000 : 0);
+        published.state = session_state;
+        published.deadline_ns = deadline;
+    }
+    
+    int streak = get_current_streak();
+    int today = get_today_sessions_count();
+    if (streak != published.streak || today != published.today_sessions || strcmp(today_date, published.date) != 0) {
+        daemon_queue("stats %d %d %s\n", streak, today, today_date);
+        published.streak = streak;
+        published.today_sessions = today;
+        safe_strncpy(published.date, today_date, sizeof(published.date));
+    }
+    
+    if (client_diff_len == 0) {
+        return;
+    }
+    
+    const char *data = client_diff;
+    int len = client_diff_len;
+    if (client_diff_len < 0) {
+        len = daemon_format_state(daemon_out, sizeof(daemon_out));
+        data = daemon_out;
+    } else {
+        daemon_queue("sync\n");
+        len = client_diff_len;
+    }
+    if (len > 0) {
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            client_send(&clients[i], data, len);
+        }
+    }
+    client_diff_len = 0;
+}
+
+// As a client, send a command to the daemon instead of running it; 1 if sent
+int forward_to_daemon(const char *fmt, ...) {
+    if (daemon_fd == -1) {
+        return 0;
+    }
+    
+    char line[MAX_INPUT_LEN + 8];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line) - 1, fmt, args);
+    va_end(args);
+    if (len < 0) {
+        return 1;
+    }
+    if (len > (int)sizeof(line) - 2) {
+        len = sizeof(line) - 2;
+    }
+    line[len++] = '\n';
+    
+    if (send(daemon_fd, line, len, MSG_NOSIGNAL) != len) {
+        show_notification("Lost connection to the daemon", 2);
+    }
+    return 1;
+}
+
+void on_daemon_ready(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    ssize_t got = read(fd, daemon_in + daemon_in_len, sizeof(daemon_in) - daemon_in_len);
+    if (got <= 0) {
+        if (got == 0 || errno != EINTR) {
+            daemon_lost = 1;
+            running = 0;
+        }
+        return;
+    }
+    daemon_in_len += got;
+    
+    frame_begin();
+    char *start = daemon_in;
+    char *newline;
+    while ((newline = memchr(start, '\n', daemon_in + daemon_in_len - start)) != NULL) {
+        *newline = '\0';
+        client_apply_line(start);
+        start = newline + 1;
+    }
+    daemon_in_len -= start - daemon_in;
+    memmove(daemon_in, start, daemon_in_len);
+    if (daemon_in_len == (int)sizeof(daemon_in)) {
+        daemon_in_len = 0;  // Longer than any line the daemon sends
+    }
+    frame_end();
+}
+
+// Mirror one line of daemon state; the screen is redrawn at "sync"
+void client_apply_line(char *line) {
+    int index;
+    int used = 0;
+    if (strncmp(line, "state ", 6) == 0) {
+        int state;
+        long long left_ms;
+        if (sscanf(line + 6, "%d %lld", &state, &left_ms) == 2) {
+            session_state = state;
+            session_deadline_ns = monotonic_ns() + left_ms * 1000000;
+            timer_seconds = state == SESSION_INACTIVE ? FOCUS_DURATION
+                                                      : remaining_seconds(session_deadline_ns, monotonic_ns());
+        }
+    } else if (strncmp(line, "stats ", 6) == 0) {
+        char date[DATE_STR_LEN] = "";
+        if (sscanf(line + 6, "%d %d %10s", &daemon_streak, &daemon_today, date) == 3) {
+            safe_strncpy(today_date, date, DATE_STR_LEN);
+        }
+    } else if (strncmp(line, "focus ", 6) == 0) {
+        safe_strncpy(focus_task, line + 6, MAX_TASK_LEN);
+    } else if (strcmp(line, "clear") == 0) {
+        num_tasks = 0;
+    } else if (strncmp(line, "task ", 5) == 0 && line[5] != '\0' && line[6] == ' ') {
+        if (num_tasks < MAX_TASKS) {
+            tasks[num_tasks].done = line[5] == '1';
+            safe_strncpy(tasks[num_tasks].task, line + 7, MAX_TASK_LEN);
+            num_tasks++;
+        }
+    } else if (strncmp(line, "add ", 4) == 0) {
+        if (num_tasks < MAX_TASKS) {
+            tasks[num_tasks].done = 0;
+            safe_strncpy(tasks[num_tasks].task, line + 4, MAX_TASK_LEN);
+            num_tasks++;
+        }
+    } else if (sscanf(line, "done %d", &index) == 1 || sscanf(line, "undone %d", &index) == 1) {
+        if (index >= 0 && index < num_tasks) {
+            tasks[index].done = line[0] == 'd';
+        }
+    } else if (sscanf(line, "remove %d", &index) == 1) {
+        if (index >= 0 && index < num_tasks) {
+            memmove(&tasks[index], &tasks[index + 1], (num_tasks - index - 1) * sizeof(Task));
+            num_tasks--;
+        }
+    } else if (sscanf(line, "edit %d %n", &index, &used) == 1 && used > 0) {
+        if (index >= 0 && index < num_tasks) {
+            safe_strncpy(tasks[index].task, line + used, MAX_TASK_LEN);
+        }
+    } else if (sscanf(line, "insert %d %n", &index, &used) == 1 && used > 0) {
+        if (index >= 0 && index <= num_tasks && num_tasks < MAX_TASKS) {
+            memmove(&tasks[index + 1], &tasks[index], (num_tasks - index) * sizeof(Task));
+            safe_strncpy(tasks[index].task, line + used, MAX_TASK_LEN);
+            tasks[index].done = 0;
+            num_tasks++;
+        }
+    } else if (strncmp(line, "notify ", 7) == 0) {
+        int duration;
+        if (sscanf(line + 7, "%d %n", &duration, &used) == 1 && used > 0) {
+            show_notification(line + 7 + used, duration);
+        }
+    } else if (strcmp(line, "sync") == 0) {
+        if (current_task_index >= num_tasks) {
+            current_task_index = num_tasks > 0 ? num_tasks - 1 : 0;
+        }
+        display_screen();
+    }
+}
+
+/* feed.sock streams what happens as NDJSON, one object per line, for hooks
+ * and integrations. Subscribers connect and read; anything they send is
+ * ignored. Every object has "seq", counting up per process, "at", the wall
+ * time in seconds, and "event":
+ *   session_started {task, seconds}   break_started {seconds}   ready
+ *   session_completed {task, date, time, duration}   streak_changed {streak, max}
+ *   task_added / task_done / task_undone / task_removed {number, task}
+ *   task_edited {number, task, was}   focus_changed {task}
+ *   dropped {count}: that many objects before this one never reached you
+ * Each subscriber has a FEED_RING_SIZE ring. A subscriber that falls
+ * behind loses objects, counted in "dropped", and never holds up the timer.
+ * The process that writes the status page serves the feed. */
+void feed_open() {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(feed_file) >= sizeof(addr.sun_path)) {
+        LOG_WARN("Path too long for the event feed socket");
+        return;
+    }
+    safe_strncpy(addr.sun_path, feed_file, sizeof(addr.sun_path));
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return;
     }
     
-    return 0;
+    // A socket nobody answers on was left by an instance that did not exit cleanly
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        close(fd);
+        return;
+    }
+    close(fd);
+    unlink(feed_file);
+    
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    mode_t old_mask = umask(077);
+    int bound = fd != -1 ? bind(fd, (struct sockaddr *)&addr, sizeof(addr)) : -1;
+    umask(old_mask);
+    if (bound == -1 || listen(fd, MAX_SUBSCRIBERS) == -1 || event_add(fd, EPOLLIN, on_feed_listen_ready, NULL) == NULL) {
+        LOG_WARN("Cannot serve the event feed");
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+    feed_listen_fd = fd;
+    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+        subscribers[i].fd = -1;
+    }
 }
 
-// Improved date validation
-int is_date_valid(const char *date_str) {
-    if (!date_str || strlen(date_str) != 10) {
-        return 0;
+void feed_close() {
+    if (feed_listen_fd == -1) {
+        return;
     }
     
-    // Check format YYYY-MM-DD
-    if (date_str[4] != '-' || date_str[7] != '-') {
+    // Flush what the subscribers can take without waiting, then go
+    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].fd != -1) {
+            feed_flush(&subscribers[i]);
+            feed_drop_subscriber(&subscribers[i]);
+        }
+    }
+    close(feed_listen_fd);
+    feed_listen_fd = -1;
+    unlink(feed_file);
+}
+
+void on_feed_listen_ready(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    int sub_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (sub_fd == -1) {
+        return;
+    }
+    
+    FeedSubscriber *sub = NULL;
+    for (int i = 0; i < MAX_SUBSCRIBERS && sub == NULL; i++) {
+        if (subscribers[i].fd == -1) {
+            sub = &subscribers[i];
+        }
+    }
+    char *ring = sub != NULL ? malloc(FEED_RING_SIZE) : NULL;
+    EventSource *src = ring != NULL ? event_add(sub_fd, EPOLLIN, on_subscriber_ready, sub) : NULL;
+    if (src == NULL) {
+        free(ring);
+        close(sub_fd);
+        return;
+    }
+    
+    sub->fd = sub_fd;
+    sub->src = src;
+    sub->ring = ring;
+    sub->head = 0;
+    sub->len = 0;
+    sub->dropped = 0;
+    sub->waiting = 0;
+    feed_subscriber_count++;
+}
+
+void on_subscriber_ready(int fd, uint32_t events, void *ctx) {
+    FeedSubscriber *sub = ctx;
+    if (events & EPOLLIN) {
+        char discard[256];
+        ssize_t got;
+        while ((got = recv(fd, discard, sizeof(discard), MSG_DONTWAIT)) > 0) {
+        }
+        if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+            feed_drop_subscriber(sub);
+            return;
+        }
+    }
+    if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+        feed_flush(sub);
+    }
+}
+
+// Safe on a slot already dropped, as feed_flush() does when the peer is gone
+void feed_drop_subscriber(FeedSubscriber *sub) {
+    if (sub->fd == -1) {
+        return;
+    }
+    event_remove(sub->src);
+    close(sub->fd);
+    free(sub->ring);
+    sub->fd = -1;
+    sub->src = NULL;
+    sub->ring = NULL;
+    feed_subscriber_count--;
+}
+
+// Copy line into the ring if it fits whole; lines are never split
+int feed_push(FeedSubscriber *sub, const char *line, int len) {
+    if (len > FEED_RING_SIZE - sub->len) {
         return 0;
     }
     
-    // Check if all other characters are digits
-    for (int i = 0; i < 10; i++) {
-        if (i == 4 || i == 7) continue;
+    int tail = (sub->head + sub->len) % FEED_RING_SIZE;
+    int first = len < FEED_RING_SIZE - tail ? len : FEED_RING_SIZE - tail;
+    memcpy(sub->ring + tail, line, first);
+    memcpy(sub->ring, line + first, len - first);
+    sub->len += len;
+    return 1;
+}
+
+// Send what the socket takes now; wait for EPOLLOUT for the rest
+void feed_flush(FeedSubscriber *sub) {
+    while (sub->len > 0) {
+        int chunk = sub->len < FEED_RING_SIZE - sub->head ? sub->len : FEED_RING_SIZE - sub->head;
+        ssize_t sent = send(sub->fd, sub->ring + sub->head, chunk, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                feed_drop_subscriber(sub);
+                return;
+            }
+            break;
+        }
+        sub->head = (sub->head + sent) % FEED_RING_SIZE;
+        sub->len -= sent;
+    }
+    
+    int waiting = sub->len > 0;
+    if (waiting != sub->waiting) {
+        event_modify(sub->src, waiting ? EPOLLIN | EPOLLOUT : EPOLLIN);
+        sub->waiting = waiting;
+    }
+}
+
+// One object to every subscriber; fmt gives the fields after "event"
+void feed_emit(const char *event, const char *fmt, ...) {
+    if (feed_subscriber_count == 0) {
+        return;
+    }
+    
+    char line[FEED_LINE_SIZE];
+    int len = snprintf(line, sizeof(line), "{\"seq\":%lld,\"at\":%lld,\"event\":\"%s\"", ++feed_seq,
+                       (long long)wall_time(), event);
+    if (fmt != NULL) {
+        va_list args;
+        va_start(args, fmt);
+        len += vsnprintf(line + len, sizeof(line) - len, fmt, args);
+        va_end(args);
+    }
+    if (len > (int)sizeof(line) - 3) {
+        return;  // Fields are escaped task text, well short of this
+    }
+    len += snprintf(line + len, sizeof(line) - len, "}\n");
+    
+    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+        FeedSubscriber *sub = &subscribers[i];
+        if (sub->fd == -1) {
+            continue;
+        }
         
-        if (date_str[i] < '0' || date_str[i] > '9') {
-            return 0;
+        // Say what was lost before anything newer, once there is room to
+        if (sub->dropped > 0) {
+            char notice[96];
+            int notice_len = snprintf(notice, sizeof(notice), "{\"at\":%lld,\"event\":\"dropped\",\"count\":%ld}\n",
+                                      (long long)wall_time(), sub->dropped);
+            if (feed_push(sub, notice, notice_len)) {
+                sub->dropped = 0;
+            }
+        }
+        if (sub->dropped > 0 || !feed_push(sub, line, len)) {
+            sub->dropped++;
+            continue;
+        }
+        if (!sub->waiting) {
+            feed_flush(sub);
+        }
+    }
+}
+
+// text as the inside of a JSON string
+const char *json_escape(const char *text, char *out, int size) {
+    int len = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0' && len < size - 7; p++) {
+        if (*p == '"' || *p == '\\') {
+            out[len++] = '\\';
+            out[len++] = *p;
+        } else if (*p < 0x20) {
+            len += snprintf(out + len, size - len, "\\u%04x", *p);
+        } else {
+            out[len++] = *p;
         }
     }
+    out[len] = '\0';
+    return out;
+}
+
+// Announce a state event just applied; task and streak hold what came before
+void feed_state_event(const StateEvent *ev, const char *old_task, int old_streak) {
+    char task[MAX_TASK_LEN * 6];
+    char was[MAX_TASK_LEN * 6];
+    int number = ev->index + 1;
+    
+    switch (ev->type) {
+        case EV_TASK_ADD:
+        case EV_TASK_INSERT:
+            number = ev->type == EV_TASK_ADD ? num_tasks : number;
+            feed_emit("task_added", ",\"number\":%d,\"task\":\"%s\"", number, json_escape(ev->text, task, sizeof(task)));
+            break;
+            
+        case EV_TASK_DONE:
+        case EV_TASK_UNDONE:
+        case EV_TASK_REMOVE:
+            feed_emit(ev->type == EV_TASK_DONE ? "task_done" : ev->type == EV_TASK_UNDONE ? "task_undone" : "task_removed",
+                      ",\"number\":%d,\"task\":\"%s\"", number, json_escape(old_task, task, sizeof(task)));
+            break;
+            
+        case EV_TASK_EDIT:
+            feed_emit("task_edited", ",\"number\":%d,\"task\":\"%s\",\"was\":\"%s\"", number,
+                      json_escape(ev->text, task, sizeof(task)), json_escape(old_task, was, sizeof(was)));
+            break;
+            
+        case EV_FOCUS:
+            feed_emit("focus_changed", ",\"task\":\"%s\"", json_escape(ev->text, task, sizeof(task)));
+            break;
+            
+        case EV_SESSION_LOG: {
+            char date_part[DATE_STR_LEN];
+            char time_part[TIME_STR_LEN];
+            int duration;
+            char task_part[MAX_TASK_LEN];
+            if (parse_csv_line(ev->text, date_part, time_part, &duration, task_part)) {
+                feed_emit("session_completed", ",\"task\":\"%s\",\"date\":\"%s\",\"time\":\"%s\",\"duration\":%d",
+                          json_escape(task_part, task, sizeof(task)), date_part, time_part, duration);
+            }
+            if (streaks.streak_current != old_streak) {
+                feed_emit("streak_changed", ",\"streak\":%d,\"max\":%d", streaks.streak_current, streaks.streak_max);
+            }
+            break;
+        }
+            
+        default:
+            // Phases are announced by schedule_phase(), which also sees expiries
+            break;
+    }
+}
+
+// Called on every phase change; only a real change is announced
+void feed_phase() {
+    static int fed_state = SESSION_INACTIVE;
+    if (session_state == fed_state) {
+        return;
+    }
+    fed_state = session_state;
     
-    // Basic range checking
-    int year = atoi(date_str);
-    int month = atoi(date_str + 5);
-    int day = atoi(date_str + 8);
+    char task[MAX_TASK_LEN * 6];
+    int seconds = remaining_seconds(session_deadline_ns, monotonic_ns());
+    if (session_state == SESSION_FOCUS) {
+        feed_emit("session_started", ",\"task\":\"%s\",\"seconds\":%d", json_escape(focus_task, task, sizeof(task)), seconds);
+    } else if (session_state == SESSION_BREAK) {
+        feed_emit("break_started", ",\"seconds\":%d", seconds);
+    } else {
+        feed_emit("ready", NULL);
+    }
+}
+
+/* Prometheus metrics, opt in: --metrics-port=PORT answers GET /metrics on
+ * 127.0.0.1, --metrics-file=PATH rewrites a node_exporter textfile every
+ * 15 seconds. Gauges are read from the state at scrape time. Counters and
+ * histograms are bumped with relaxed atomic adds where things happen, on
+ * whichever thread, and read the same way; nothing is locked and nothing
+ * is allocated. Like the feed, only the status page's writer serves them. */
+void metric_add(uint64_t *counter, uint64_t n) {
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+void histogram_observe(Histogram *hist, long long ns) {
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS && ns > metrics_bounds_ns[bucket]) {
+        bucket++;
+    }
+    metric_add(&hist->buckets[bucket], 1);
+    metric_add(&hist->sum_ns, ns > 0 ? ns : 0);
+}
+
+// Exposition text format; returns the length
+int metrics_format(char *buf, int size) {
+    int open = 0;
+    for (int i = 0; i < num_tasks; i++) {
+        open += !tasks[i].done;
+    }
+    int remaining = session_state != SESSION_INACTIVE ? remaining_seconds(session_deadline_ns, monotonic_ns()) : 0;
+    
+    int len = snprintf(buf, size,
+        "# HELP focusforge_session_phase Current phase: 0 idle, 1 focus, 2 break.\n"
+        "# TYPE focusforge_session_phase gauge\n"
+        "focusforge_session_phase %d\n"
+        "# HELP focusforge_remaining_seconds Seconds left in the current phase.\n"
+        "# TYPE focusforge_remaining_seconds gauge\n"
+        "focusforge_remaining_seconds %d\n"
+        "# HELP focusforge_tasks Tasks in the list.\n"
+        "# TYPE focusforge_tasks gauge\n"
+        "focusforge_tasks{state=\"open\"} %d\n"
+        "focusforge_tasks{state=\"done\"} %d\n"
+        "# HELP focusforge_today_sessions Focus sessions logged today.\n"
+        "# TYPE focusforge_today_sessions gauge\n"
+        "focusforge_today_sessions %d\n"
+        "# HELP focusforge_streak_days Days in a row with a logged session.\n"
+        "# TYPE focusforge_streak_days gauge\n"
+        "focusforge_streak_days %d\n"
+        "# HELP focusforge_sessions_logged_total Focus sessions logged by this process.\n"
+        "# TYPE focusforge_sessions_logged_total counter\n"
+        "focusforge_sessions_logged_total %llu\n"
+        "# HELP focusforge_saves_total Files written or appended to.\n"
+        "# TYPE focusforge_saves_total counter\n"
+        "focusforge_saves_total %llu\n"
+        "# HELP focusforge_written_bytes_total Bytes written to the data directory.\n"
+        "# TYPE focusforge_written_bytes_total counter\n"
+        "focusforge_written_bytes_total %llu\n"
+        "# HELP focusforge_fsyncs_total fdatasync() calls.\n"
+        "# TYPE focusforge_fsyncs_total counter\n"
+        "focusforge_fsyncs_total %llu\n",
+        session_state, remaining, open, num_tasks - open, get_today_sessions_count(), get_current_streak(),
+        (unsigned long long)__atomic_load_n(&metrics.sessions_logged, __ATOMIC_RELAXED),
+        (unsigned long long)__atomic_load_n(&metrics.saves, __ATOMIC_RELAXED),
+        (unsigned long long)__atomic_load_n(&metrics.bytes_written, __ATOMIC_RELAXED),
+        (unsigned long long)__atomic_load_n(&metrics.fsyncs, __ATOMIC_RELAXED));
+    if (len < 0 || len >= size) {
+        return 0;
+    }
+    // A daemon has no keys and no terminal, so nothing to observe
+    if (!headless) {
+        len += metrics_format_histogram(buf + len, size - len, "focusforge_keypress_latency_seconds",
+                                        "Time from a keypress to its frame on the terminal.", &metrics.keypress_latency);
+    }
+    len += metrics_format_histogram(buf + len, size - len, "focusforge_save_latency_seconds",
+                                    "Time the writer thread took per file write.", &metrics.save_latency);
+    return len;
+}
+
+// One histogram, buckets made cumulative; returns the length, 0 if it does not fit
+int metrics_format_histogram(char *buf, int size, const char *name, const char *help, const Histogram *hist) {
+    int len = snprintf(buf, size, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    unsigned long long count = 0;
+    for (int i = 0; i <= METRICS_BUCKETS && len >= 0 && len < size; i++) {
+        count += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        if (i < METRICS_BUCKETS) {
+            len += snprintf(buf + len, size - len, "%s_bucket{le=\"%g\"} %llu\n", name, metrics_bounds_ns[i] / 1e9, count);
+        } else {
+            len += snprintf(buf + len, size - len, "%s_bucket{le=\"+Inf\"} %llu\n", name, count);
+        }
+    }
+    if (len >= 0 && len < size) {
+        len += snprintf(buf + len, size - len, "%s_sum %.9f\n%s_count %llu\n", name,
+                        __atomic_load_n(&hist->sum_ns, __ATOMIC_RELAXED) / 1e9, name, count);
+    }
+    if (len < 0 || len >= size) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return len;
+}
+
+void metrics_open() {
+    if (metrics_port > 0) {
+        for (int i = 0; i < MAX_SCRAPERS; i++) {
+            scrapers[i].fd = -1;
+        }
+        struct sockaddr_in addr = { .sin_family = AF_INET };
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(metrics_port);
+        int one = 1;
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 ||
+            bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 16) == -1 ||
+            event_add(fd, EPOLLIN, on_metrics_listen_ready, NULL) == NULL) {
+            show_notification("Cannot serve metrics on that port", 2);
+            if (fd != -1) {
+                close(fd);
+            }
+        } else {
+            metrics_listen_fd = fd;
+        }
+    }
+    if (metrics_file != NULL) {
+        timer_init(&metrics_file_timer, "metrics", on_metrics_file_due, NULL);
+        on_metrics_file_due(&metrics_file_timer, NULL);
+    }
+}
+
+void on_metrics_listen_ready(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused))) {
+    int conn_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (conn_fd == -1) {
+        return;
+    }
     
-    if (year < 2000 || year > 2100) return 0;
-    if (month < 1 || month > 12) return 0;
-    if (day < 1 || day > 31) return 0;
+    Scraper *scraper = NULL;
+    for (int i = 0; i < MAX_SCRAPERS && scraper == NULL; i++) {
+        if (scrapers[i].fd == -1) {
+            scraper = &scrapers[i];
+        }
+    }
+    if (scraper == NULL) {
+        close(conn_fd);
+        return;
+    }
     
-    return 1;
+    scraper->src = event_add(conn_fd, EPOLLIN, on_metrics_conn_ready, scraper);
+    if (scraper->src == NULL) {
+        close(conn_fd);
+        return;
+    }
+    scraper->fd = conn_fd;
+    scraper->len = 0;
+    timer_init(&scraper->idle, "scrape", on_scraper_idle, scraper);
+    timer_start(&timer_wheel, &scraper->idle, monotonic_ns() + SCRAPE_IDLE_NS);
+}
+
+// Answered once the whole header is in, however many segments it came in
+void on_metrics_conn_ready(int fd, uint32_t events __attribute__((unused)), void *ctx) {
+    Scraper *scraper = ctx;
+    ssize_t got = recv(fd, scraper->request + scraper->len, sizeof(scraper->request) - 1 - scraper->len, MSG_DONTWAIT);
+    if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (got <= 0) {
+        scraper_close(scraper);
+        return;
+    }
+    scraper->len += got;
+    scraper->request[scraper->len] = '\0';
+    
+    static char reply[METRICS_SIZE];
+    static char body[METRICS_SIZE - 128];
+    int len;
+    if (strstr(scraper->request, "\r\n\r\n") == NULL && strstr(scraper->request, "\n\n") == NULL) {
+        if (scraper->len < (int)sizeof(scraper->request) - 1) {
+            return;
+        }
+        len = snprintf(reply, sizeof(reply), "HTTP/1.0 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    } else if (strncmp(scraper->request, "GET /metrics ", 13) == 0 || strncmp(scraper->request, "GET /metrics?", 13) == 0) {
+        int body_len = metrics_format(body, sizeof(body));
+        len = snprintf(reply, sizeof(reply), "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                       "Content-Length: %d\r\nConnection: close\r\n\r\n%s", body_len, body);
+    } else {
+        len = snprintf(reply, sizeof(reply), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+    if (send(fd, reply, len, MSG_NOSIGNAL) != len) {
+        LOG_WARN("Metrics reply cut short");
+    }
+    scraper_close(scraper);
+}
+
+void on_scraper_idle(Timer *timer __attribute__((unused)), void *ctx) {
+    scraper_close(ctx);
+}
+
+void scraper_close(Scraper *scraper) {
+    timer_cancel(&timer_wheel, &scraper->idle);
+    event_remove(scraper->src);
+    close(scraper->fd);
+    scraper->fd = -1;
+}
+
+void on_metrics_file_due(Timer *timer, void *ctx __attribute__((unused))) {
+    char *text = persist_reserve(PR_METRICS, METRICS_SIZE);
+    persist_commit(metrics_format(text, METRICS_SIZE));
+    timer_start(&timer_wheel, timer, monotonic_ns() + METRICS_FILE_INTERVAL_NS);
+}
+
+/* --server hosts many users in one process. Each user is a shard with its
+ * own tasks, session and streak behind its own mutex, persisted to
+ * <root>/<user>/events.log in the same format as a single-user events.log,
+ * so `focusforge --data-dir=<root>/<user>` opens it directly. A pool of
+ * workers serves connections from one epoll set; EPOLLONESHOT hands each
+ * ready connection to exactly one worker. All running pomodoros share one
+ * timing wheel driven by a timer thread.
+ *
+ * Locks are taken shard first, then server_wheel_lock. The wheel callback
+ * only collects due shards; they are locked after the wheel is released.
+ *
+ * One request per line, one reply line per request:
+ *   user <name>            Select the shard; letters, digits, '.', '_', '-'
+ *   cmd <command>          Any command-line input: ok|err <message>
+ *   status                 status <phase> <ms left> <today's sessions> <streak> <tasks> */
+Shard *shard_get(const char *user) {
+    unsigned bucket = fnv1a(user, strlen(user)) % SHARD_BUCKETS;
+    
+    pthread_mutex_lock(&shard_table_lock);
+    Shard *shard = shard_table[bucket];
+    while (shard != NULL && strcmp(shard->user, user) != 0) {
+        shard = shard->next;
+    }
+    if (shard != NULL) {
+        pthread_mutex_unlock(&shard_table_lock);
+        return shard;
+    }
+    
+    shard = calloc(1, sizeof(Shard));
+    if (shard == NULL) {
+        pthread_mutex_unlock(&shard_table_lock);
+        return NULL;
+    }
+    safe_strncpy(shard->user, user, sizeof(shard->user));
+    safe_strncpy(shard->focus_task, "???", sizeof(shard->focus_task));
+    shard->events_fd = -1;
+    pthread_mutex_init(&shard->lock, NULL);
+    timer_init(&shard->phase_timer, "shard phase", shard_phase_due, shard);
+    
+    // Published locked: lookups of this user wait here until it is loaded,
+    // while other users carry on
+    pthread_mutex_lock(&shard->lock);
+    shard->next = shard_table[bucket];
+    shard_table[bucket] = shard;
+    shard_count++;
+    pthread_mutex_unlock(&shard_table_lock);
+    
+    shard_load(shard);
+    pthread_mutex_unlock(&shard->lock);
+    return shard;
+}
+
+void shard_load(Shard *shard) {
+    char dir[MAX_PATH_LEN + SHARD_NAME_LEN + 1];
+    char path[sizeof(dir) + 16];
+    snprintf(dir, sizeof(dir), "%s/%s", server_root, shard->user);
+    snprintf(path, sizeof(path), "%s/events.log", dir);
+    if (mkdir(dir, 0700) == -1 && errno != EEXIST) {
+        fprintf(stderr, "Error creating %s: %s\n", dir, strerror(errno));
+        return;
+    }
+    
+    shard->events_fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (shard->events_fd == -1) {
+        fprintf(stderr, "Error opening %s: %s\n", path, strerror(errno));
+        return;
+    }
+    
+    FILE *fp = fdopen(dup(shard->events_fd), "r");
+    if (fp == NULL) {
+        return;
+    }
+    char line[MAX_INPUT_LEN + 96];
+    StateEvent ev;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (state_parse_event(line, &ev) && ev.seq > shard->seq) {
+            shard_apply(shard, &ev);
+        }
+    }
+    fclose(fp);
+}
+
+// state_apply() for a shard; the running session is not part of replayed state
+void shard_apply(Shard *shard, const StateEvent *ev) {
+    shard->seq = ev->seq;
+    
+    switch (ev->type) {
+        case EV_TASK_ADD:
+            if (shard->num_tasks < MAX_TASKS) {
+                safe_strncpy(shard->tasks[shard->num_tasks].task, ev->text, MAX_TASK_LEN);
+                shard->tasks[shard->num_tasks].done = 0;
+                shard->num_tasks++;
+            }
+            break;
+            
+        case EV_TASK_DONE:
+        case EV_TASK_UNDONE:
+            if (ev->index >= 0 && ev->index < shard->num_tasks) {
+                shard->tasks[ev->index].done = ev->type == EV_TASK_DONE;
+            }
+            break;
+            
+        case EV_TASK_REMOVE:
+            if (ev->index >= 0 && ev->index < shard->num_tasks) {
+                memmove(&shard->tasks[ev->index], &shard->tasks[ev->index + 1],
+                        (shard->num_tasks - ev->index - 1) * sizeof(Task));
+                shard->num_tasks--;
+            }
+            break;
+            
+        case EV_TASK_EDIT:
+            if (ev->index >= 0 && ev->index < shard->num_tasks) {
+                safe_strncpy(shard->tasks[ev->index].task, ev->text, MAX_TASK_LEN);
+            }
+            break;
+            
+        case EV_TASK_INSERT:
+            if (shard->num_tasks < MAX_TASKS && ev->index >= 0 && ev->index <= shard->num_tasks) {
+                memmove(&shard->tasks[ev->index + 1], &shard->tasks[ev->index],
+                        (shard->num_tasks - ev->index) * sizeof(Task));
+                safe_strncpy(shard->tasks[ev->index].task, ev->text, MAX_TASK_LEN);
+                shard->tasks[ev->index].done = 0;
+                shard->num_tasks++;
+            }
+            break;
+            
+        case EV_FOCUS:
+            safe_strncpy(shard->focus_task, ev->text, MAX_TASK_LEN);
+            break;
+            
+        case EV_SESSION_LOG: {
+            char date_part[DATE_STR_LEN];
+            char time_part[TIME_STR_LEN];
+            int duration;
+            char task_part[MAX_TASK_LEN];
+            if (parse_csv_line(ev->text, date_part, time_part, &duration, task_part)) {
+                streak_count_day(&shard->streaks, shard->last_session_day, date_part);
+                if (strcmp(date_part, shard->day_stats.date) != 0) {
+                    safe_strncpy(shard->day_stats.date, date_part, DATE_STR_LEN);
+                    shard->day_stats.sessions = 0;
+                    shard->day_stats.focus_seconds = 0;
+                }
+                shard->day_stats.sessions++;
+                shard->day_stats.focus_seconds += duration;
+            }
+            break;
+        }
+            
+        default:
+            break;
+    }
+}
+
+// Append one event to the shard's log and apply it; called with the shard locked
+void shard_emit(Shard *shard, StateEventType type, int index, const char *text) {
+    StateEvent ev;
+    ev.seq = shard->seq + 1;
+    ev.at = (long long)wall_time();
+    ev.type = type;
+    ev.index = index;
+    safe_strncpy(ev.text, text, sizeof(ev.text));
+    
+    char line[MAX_INPUT_LEN + 96];
+    int len = state_format_event(&ev, line, sizeof(line));
+    if (shard->events_fd == -1 || write(shard->events_fd, line, len) != len) {
+        LOG_ERROR("Failed to write shard event log");
+    }
+    shard_apply(shard, &ev);
+}
+
+void shard_log_session(Shard *shard, long long now) {
+    long long end = now < shard->deadline_ns ? now : shard->deadline_ns;
+    int duration = (int)((end - shard->start_mono_ns + NS_PER_SEC / 2) / NS_PER_SEC);
+    
+    struct tm start_tm;
+    localtime_r(&shard->start_time, &start_tm);
+    char date_str[DATE_STR_LEN];
+    char time_str[TIME_STR_LEN];
+    strftime(date_str, DATE_STR_LEN, "%Y-%m-%d", &start_tm);
+    strftime(time_str, TIME_STR_LEN, "%H:%M", &start_tm);
+    
+    char row[MAX_INPUT_LEN];
+    snprintf(row, sizeof(row), "%s,%s,%d,\"%s\"", date_str, time_str, duration, shard->focus_task);
+    shard_emit(shard, EV_SESSION_LOG, 0, row);
+}
+
+// Keep the shard's wheel timer in step with its session; shard locked
+void shard_schedule(Shard *shard) {
+    pthread_mutex_lock(&server_wheel_lock);
+    if (shard->session_state == SESSION_INACTIVE) {
+        timer_cancel(&server_wheel, &shard->phase_timer);
+    } else {
+        timer_start(&server_wheel, &shard->phase_timer, shard->deadline_ns);
+        server_arm_timer();
+    }
+    pthread_mutex_unlock(&server_wheel_lock);
+}
+
+// Wheel callback, under server_wheel_lock: just note the shard as due
+void shard_phase_due(Timer *timer __attribute__((unused)), void *ctx) {
+    if (server_due_count == server_due_capacity) {
+        int capacity = server_due_capacity ? server_due_capacity * 2 : 64;
+        Shard **grown = realloc(server_due, capacity * sizeof(Shard *));
+        if (grown == NULL) {
+            return;
+        }
+        server_due = grown;
+        server_due_capacity = capacity;
+    }
+    server_due[server_due_count++] = ctx;
+}
+
+// on_phase_expired() for a shard; shard locked
+void shard_phase_expired(Shard *shard, long long now) {
+    // The wheel fired for a deadline since moved or cleared
+    if (shard->session_state == SESSION_INACTIVE || shard->deadline_ns > now) {
+        return;
+    }
+    
+    if (shard->session_state == SESSION_FOCUS) {
+        shard_log_session(shard, now);
+        shard->session_state = SESSION_BREAK;
+        shard->start_mono_ns = shard->deadline_ns;
+        shard->deadline_ns += BREAK_DURATION * NS_PER_SEC;
+    } else {
+        shard->session_state = SESSION_INACTIVE;
+    }
+    shard_schedule(shard);
+}
+
+// Run one parsed command against a shard, as execute_command() does; shard locked
+const char *shard_execute(Shard *shard, const ParsedCommand *cmd) {
+    long long now = monotonic_ns();
+    int task_num = 0;
+    
+    switch (cmd->type) {
+        case CMD_ADD_TASK:
+            if (cmd->argument[0] == '\0') {
+                return "err Empty task";
+            }
+            if (shard->num_tasks >= MAX_TASKS) {
+                return "err Maximum number of tasks reached";
+            }
+            shard_emit(shard, EV_TASK_ADD, 0, cmd->argument);
+            return "ok Task added";
+            
+        case CMD_SET_FOCUS:
+            if (cmd->argument[0] == '\0') {
+                return "err Empty focus task";
+            }
+            shard_emit(shard, EV_FOCUS, 0, cmd->argument);
+            return "ok Focus task updated";
+            
+        case CMD_MARK_DONE:
+        case CMD_UNMARK:
+        case CMD_REMOVE:
+            if (!validate_task_number(cmd->argument, &task_num) || task_num > shard->num_tasks) {
+                return "err Invalid task number";
+            }
+            shard_emit(shard, cmd->type == CMD_MARK_DONE ? EV_TASK_DONE : cmd->type == CMD_UNMARK ? EV_TASK_UNDONE
+                                                                                                   : EV_TASK_REMOVE,
+                       task_num - 1, "");
+            return cmd->type == CMD_MARK_DONE ? "ok Task marked as done"
+                   : cmd->type == CMD_UNMARK  ? "ok Task unmarked"
+                                              : "ok Task removed";
+            
+        case CMD_START_FOCUS:
+        case CMD_START_BREAK: {
+            if (shard->session_state != SESSION_INACTIVE) {
+                return "err Session already active";
+            }
+            int focus = cmd->type == CMD_START_FOCUS;
+            shard->session_state = focus ? SESSION_FOCUS : SESSION_BREAK;
+            shard->start_time = wall_time();
+            shard->start_mono_ns = now;
+            shard->deadline_ns = now + (focus ? FOCUS_DURATION : BREAK_DURATION) * NS_PER_SEC;
+            shard_emit(shard, EV_SESSION_START, shard->session_state, focus ? shard->focus_task : "");
+            shard_schedule(shard);
+            return focus ? "ok Focus session started" : "ok Break session started";
+        }
+            
+        case CMD_STOP:
+        case CMD_SKIP:
+            if (shard->session_state == SESSION_INACTIVE) {
+                return "err No active session";
+            }
+            if (cmd->type == CMD_STOP) {
+                if (shard->session_state == SESSION_FOCUS) {
+                    shard_log_session(shard, now);
+                }
+                shard_emit(shard, EV_SESSION_STOP, shard->session_state, "");
+            } else {
+                shard_emit(shard, EV_SESSION_SKIP, shard->session_state, "");
+                if (shard->session_state == SESSION_FOCUS) {
+                    shard_log_session(shard, now);
+                }
+            }
+            if (cmd->type == CMD_SKIP && shard->session_state == SESSION_FOCUS) {
+                shard->session_state = SESSION_BREAK;
+                shard->start_mono_ns = now;
+                shard->deadline_ns = now + BREAK_DURATION * NS_PER_SEC;
+            } else {
+                shard->session_state = SESSION_INACTIVE;
+            }
+            shard_schedule(shard);
+            return cmd->type == CMD_STOP ? "ok Session stopped" : "ok Session skipped";
+            
+        default:
+            return "err Not available on the server";
+    }
 }
 
-void update_streaks() {
-    // Get today's date
-    time_t now = time(NULL);
-    struct tm *today_tm = localtime(&now);
-    if (today_tm == NULL) {
-        return;
+// Letters, digits, '.', '_' and '-', not starting with '.': safe as a directory name
+int server_user_valid(const char *name) {
+    size_t len = strspn(name, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._-");
+    return len > 0 && name[len] == '\0' && len < SHARD_NAME_LEN && name[0] != '.';
+}
+
+/* Anyone on the machine may connect, so a connection is its peer's user:
+ * account is set to the peer's login name, or uid<N>, and nothing else can
+ * be selected. The server's owner, who can read every user's files anyway,
+ * may select any user; --bench-server relies on that. 0 if the peer is unknown. */
+int server_peer_account(int fd, char *account) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+        return 0;
     }
-    
-    char today_str[DATE_STR_LEN];
-    strftime(today_str, DATE_STR_LEN, "%Y-%m-%d", today_tm);
-    
-    // Get yesterday's date
-    time_t yesterday_time = now - 86400; // 24 hours in seconds
-    struct tm *yesterday_tm = localtime(&yesterday_time);
-    if (yesterday_tm == NULL) {
-        return;
+    account[0] = '\0';
+    if (cred.uid == geteuid()) {
+        return 1;
     }
     
-    char yesterday_str[DATE_STR_LEN];
-    strftime(yesterday_str, DATE_STR_LEN, "%Y-%m-%d", yesterday_tm);
-    
-    // Load current streak data
-    StreakData streak_data = {0, 0};
-    
-    FILE *fp = fopen(meta_file, "r");
-    if (fp != NULL) {
-        char line[256];
-        while (fgets(line, sizeof(line), fp) != NULL) {
-            if (strncmp(line, "streak_max=", 11) == 0) {
-                streak_data.streak_max = atoi(line + 11);
-            } else if (strncmp(line, "streak_current=", 15) == 0) {
-                streak_data.streak_current = atoi(line + 15);
-            }
-        }
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close meta file");
-        }
+    struct passwd pw;
+    struct passwd *found = NULL;
+    char pw_buf[1024];
+    if (getpwuid_r(cred.uid, &pw, pw_buf, sizeof(pw_buf), &found) == 0 && found != NULL && server_user_valid(pw.pw_name)) {
+        safe_strncpy(account, pw.pw_name, SHARD_NAME_LEN);
     } else {
-        // Non-fatal error, just continue
+        snprintf(account, SHARD_NAME_LEN, "uid%u", (unsigned)cred.uid);
     }
-    
-    // Check if we had a session yesterday or today to continue the streak
-    int had_session_yesterday = 0;
-    int had_session_today = 0;
-    
-    fp = fopen(sessions_file, "r");
-    if (fp != NULL) {
-        char line[512];
-        char date_part[DATE_STR_LEN];
-        char time_part[TIME_STR_LEN];
-        int duration;
-        char task_part[MAX_TASK_LEN];
-        
-        while (fgets(line, sizeof(line), fp) != NULL) {
-            if (parse_csv_line(line, date_part, time_part, &duration, task_part)) {
-                if (strcmp(date_part, yesterday_str) == 0) {
-                    had_session_yesterday = 1;
-                } else if (strcmp(date_part, today_str) == 0) {
-                    had_session_today = 1;
-                }
-            }
+    return 1;
+}
+
+// Replies to one request line; conn->shard is the user it selected
+int server_handle_line(ServerConn *conn, char *line, char *reply, int size) {
+    if (strncmp(line, "user ", 5) == 0) {
+        const char *name = line + 5;
+        if (!server_user_valid(name)) {
+            return snprintf(reply, size, "err Invalid user name\n");
         }
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close sessions file");
+        if (conn->account[0] != '\0' && strcmp(name, conn->account) != 0) {
+            return snprintf(reply, size, "err You can only be %s\n", conn->account);
         }
+        conn->shard = shard_get(name);
+        return snprintf(reply, size, conn->shard ? "ok\n" : "err Out of memory\n");
     }
     
-    // Update streaks based on session history
-    if (had_session_today) {
-        // Don't update if already counted today
-        return;
+    // Other users are who their account says, without asking
+    if (conn->shard == NULL && conn->account[0] != '\0') {
+        conn->shard = shard_get(conn->account);
+    }
+    Shard *shard = conn->shard;
+    if (shard == NULL) {
+        return snprintf(reply, size, "err Select a user first\n");
     }
     
-    if (had_session_yesterday) {
-        streak_data.streak_current++;
-        if (streak_data.streak_current > streak_data.streak_max) {
-            streak_data.streak_max = streak_data.streak_current;
-        }
-    } else {
-        // No session yesterday means we break the streak
-        streak_data.streak_current = 1;
+    if (strcmp(line, "status") == 0) {
+        // Dates straight from the clock; no shared day cache to lock
+        char today[DATE_STR_LEN];
+        char yesterday[DATE_STR_LEN];
+        time_t now_wall = wall_time();
+        struct tm tm;
+        localtime_r(&now_wall, &tm);
+        strftime(today, DATE_STR_LEN, "%Y-%m-%d", &tm);
+        calendar_yesterday(today, yesterday);
+        
+        long long now = monotonic_ns();
+        pthread_mutex_lock(&shard->lock);
+        long long left_ms = shard->session_state != SESSION_INACTIVE && shard->deadline_ns > now
+                                ? (shard->deadline_ns - now) / 1000000 : 0;
+        int today_sessions = strcmp(shard->day_stats.date, today) == 0 ? shard->day_stats.sessions : 0;
+        int streak = strcmp(shard->last_session_day, today) == 0 || strcmp(shard->last_session_day, yesterday) == 0
+                         ? shard->streaks.streak_current : 0;
+        int len = snprintf(reply, size, "status %d %lld %d %d %d\n", shard->session_state, left_ms,
+                           today_sessions, streak, shard->num_tasks);
+        pthread_mutex_unlock(&shard->lock);
+        return len;
     }
     
-    // Write updated streak data back to file
-    fp = fopen(meta_file, "w");
-    if (fp != NULL) {
-        fprintf(fp, "streak_max=%d\nstreak_current=%d\n", streak_data.streak_max, streak_data.streak_current);
-        if (fclose(fp) != 0) {
-            LOG_ERROR("Error closing meta file");
-        }
-    } else {
-        LOG_ERROR("Error writing to meta file");
+    ParsedCommand cmd;
+    if (strncmp(line, "cmd ", 4) != 0 || !parse_command_input(line + 4, &cmd)) {
+        return snprintf(reply, size, "err Unknown request\n");
     }
+    
+    pthread_mutex_lock(&shard->lock);
+    const char *result = shard_execute(shard, &cmd);
+    pthread_mutex_unlock(&shard->lock);
+    return snprintf(reply, size, "%s\n", result);
 }
 
-int get_today_sessions_count() {
-    time_t now = time(NULL);
-    struct tm *today_tm = localtime(&now);
-    if (today_tm == NULL) {
-        return 0;
+// The day before day (YYYY-MM-DD) by calendar, without mktime()'s time zone lock
+void calendar_yesterday(const char *day, char *out) {
+    struct tm tm = {0};
+    if (sscanf(day, "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3) {
+        out[0] = '\0';
+        return;
     }
-    
-    char today_str[DATE_STR_LEN];
-    strftime(today_str, DATE_STR_LEN, "%Y-%m-%d", today_tm);
-    
-    int count = 0;
-    FILE *fp = fopen(sessions_file, "r");
-    if (fp != NULL) {
-        char line[512];
-        char date_part[DATE_STR_LEN];
-        char time_part[TIME_STR_LEN];
-        int duration;
-        char task_part[MAX_TASK_LEN];
-        
-        while (fgets(line, sizeof(line), fp) != NULL) {
-            if (parse_csv_line(line, date_part, time_part, &duration, task_part)) {
-                if (strcmp(date_part, today_str) == 0) {
-                    count++;
-                }
-            }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_mday--;
+    tm.tm_hour = 12;
+    time_t t = timegm(&tm);
+    gmtime_r(&t, &tm);
+    strftime(out, DATE_STR_LEN, "%Y-%m-%d", &tm);
+}
+
+// Point server_timer_fd at the wheel's next expiry; server_wheel_lock held
+void server_arm_timer() {
+    long long wake = wheel_next_expiry_ns(&server_wheel);
+    if (wake < 0) {
+        wake = 0;
+    } else if (wake == 0) {
+        wake = 1;
+    }
+    struct itimerspec spec = {
+        .it_interval = { 0, 0 },
+        .it_value = { wake / NS_PER_SEC, wake % NS_PER_SEC },
+    };
+    timerfd_settime(server_timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void *server_timer_thread(void *arg __attribute__((unused))) {
+    for (;;) {
+        uint64_t expirations;
+        if (read(server_timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN && errno != EINTR) {
+            LOG_ERROR("Failed to read server timer");
         }
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close sessions file");
+        
+        long long now = monotonic_ns();
+        pthread_mutex_lock(&server_wheel_lock);
+        server_due_count = 0;
+        wheel_advance(&server_wheel, now);
+        server_arm_timer();
+        pthread_mutex_unlock(&server_wheel_lock);
+        
+        // server_due is only touched by this thread and the callback it runs
+        for (int i = 0; i < server_due_count; i++) {
+            pthread_mutex_lock(&server_due[i]->lock);
+            shard_phase_expired(server_due[i], now);
+            pthread_mutex_unlock(&server_due[i]->lock);
         }
     }
-    
-    return count;
+    return NULL;
 }
 
-int get_current_streak() {
-    StreakData streak_data = {0, 0};
-    
-    FILE *fp = fopen(meta_file, "r");
-    if (fp != NULL) {
-        char line[256];
-        while (fgets(line, sizeof(line), fp) != NULL) {
-            if (strncmp(line, "streak_max=", 11) == 0) {
-                streak_data.streak_max = atoi(line + 11);
-            } else if (strncmp(line, "streak_current=", 15) == 0) {
-                streak_data.streak_current = atoi(line + 15);
-            }
+void server_accept() {
+    int fd;
+    while ((fd = accept4(server_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        ServerConn *conn = calloc(1, sizeof(ServerConn));
+        if (conn == NULL) {
+            close(fd);
+            continue;
         }
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close meta file");
+        conn->fd = fd;
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.ptr = conn };
+        if (!server_peer_account(fd, conn->account) || epoll_ctl(server_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            close(fd);
+            free(conn);
         }
     }
-    
-    return streak_data.streak_current;
 }
 
-void display_sessions() {
-    time_t now = time(NULL);
-    struct tm *today_tm = localtime(&now);
-    if (today_tm == NULL) {
+// Read what the connection sent, answer every complete line with one send()
+void server_serve(ServerConn *conn) {
+    // A client that stops reading gets nothing more read until it catches up,
+    // and holds up no worker meanwhile
+    if (!server_flush(conn)) {
+        close(conn->fd);  // Also drops it from the epoll set
+        free(conn);
         return;
     }
+    if (conn->out_len == 0 && conn->len < (int)sizeof(conn->buf) - 1) {
+        ssize_t got = recv(conn->fd, conn->buf + conn->len, sizeof(conn->buf) - 1 - conn->len, 0);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+            close(conn->fd);
+            free(conn);
+            return;
+        }
+        if (got > 0) {
+            conn->len += got;
+        }
+    }
     
-    char today_str[DATE_STR_LEN];
-    strftime(today_str, DATE_STR_LEN, "%Y-%m-%d", today_tm);
-    
-    // Create a new window for session display
-    int height = LINES - 4;
-    int width = COLS - 4;
-    int start_y = 2;
-    int start_x = 2;
-    
-    if (height <= 4 || width <= 4) {
-        show_notification("Terminal too small for session display", 2);
-        return;
+    // Answer the complete lines there is reply room for; the rest wait
+    char *start = conn->buf;
+    char *newline;
+    while (conn->out_len <= (int)sizeof(conn->out) - MAX_INPUT_LEN &&
+           (newline = memchr(start, '\n', conn->buf + conn->len - start)) != NULL) {
+        *newline = '\0';
+        conn->out_len += server_handle_line(conn, start, conn->out + conn->out_len, sizeof(conn->out) - conn->out_len);
+        start = newline + 1;
+    }
+    conn->len -= start - conn->buf;
+    memmove(conn->buf, start, conn->len);
+    if (conn->len == (int)sizeof(conn->buf) - 1 && memchr(conn->buf, '\n', conn->len) == NULL) {
+        conn->len = 0;  // No request is this long
     }
     
-    WINDOW *session_win = newwin(height, width, start_y, start_x);
-    if (session_win == NULL) {
-        show_notification("Error creating session window", 2);
+    if (!server_flush(conn)) {
+        close(conn->fd);
+        free(conn);
         return;
     }
-    
-    box(session_win, 0, 0);
-    mvwprintw(session_win, 1, 1, "SESSION LOG(%s):", today_str);
-    
-    FILE *fp = fopen(sessions_file, "r");
-    if (fp != NULL) {
-        char line[512];
-        int found_today = 0;
-        int line_count = 0;
-        
-        // First pass: check if there are any entries for today
-        while (fgets(line, sizeof(line), fp) != NULL) {
-            char date_part[DATE_STR_LEN];
-            char time_part[TIME_STR_LEN];
-            int duration;
-            char task_part[MAX_TASK_LEN];
-            
-            if (parse_csv_line(line, date_part, time_part, &duration, task_part)) {
-                if (strcmp(date_part, today_str) == 0) {
-                    found_today = 1;
-                    break;
-                }
-            }
-        }
-        
-        if (!found_today) {
-            mvwprintw(session_win, 3, 1, "(No sessions today)");
-        } else {
-            // Second pass: read from the beginning to print all today's sessions
-            rewind(fp);
-            while (fgets(line, sizeof(line), fp) != NULL && line_count < height - 4) {
-                char date_part[DATE_STR_LEN];
-                char time_part[TIME_STR_LEN];
-                int duration;
-                char task_part[MAX_TASK_LEN];
-                
-                if (parse_csv_line(line, date_part, time_part, &duration, task_part)) {
-                    if (strcmp(date_part, today_str) == 0) {
-                        // Calculate end time from start time and duration
-                        struct tm session_tm = {0};
-                        if (sscanf(date_part, "%d-%d-%d", &session_tm.tm_year, &session_tm.tm_mon, &session_tm.tm_mday) != 3) {
-                            continue;
-                        }
-                        if (sscanf(time_part, "%d:%d", &session_tm.tm_hour, &session_tm.tm_min) != 2) {
-                            continue;
-                        }
-                        session_tm.tm_year -= 1900;  // Convert to years since 1900
-                        session_tm.tm_mon -= 1;      // Convert to months since January (0-11)
-                        
-                        time_t session_start = mktime(&session_tm);
-                        if (session_start == (time_t)-1) {
-                            continue;
-                        }
-                        time_t session_end = session_start + duration;
-                        
-                        struct tm *end_tm = localtime(&session_end);
-                        if (end_tm == NULL) {
-                            continue;
-                        }
-                        char end_time_str[TIME_STR_LEN];
-                        strftime(end_time_str, TIME_STR_LEN, "%H:%M", end_tm);
-                        
-                        // Print in the requested format
-                        mvwprintw(session_win, line_count + 3, 1, "- %s–%s → %s", 
-                                 time_part, end_time_str, strlen(task_part) > 0 ? task_part : "???");
-                        line_count++;
-                    }
-                }
-            }
-        }
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close sessions file");
+    struct epoll_event ev = { .events = (conn->out_len > 0 ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT, .data.ptr = conn };
+    epoll_ctl(server_epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+// Send what the client will take now; 0 if the connection is gone
+int server_flush(ServerConn *conn) {
+    while (conn->out_len > 0) {
+        ssize_t sent = send(conn->fd, conn->out, conn->out_len, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EINTR;
         }
-    } else {
-        mvwprintw(session_win, 3, 1, "(No sessions logged)");
+        conn->out_len -= sent;
+        memmove(conn->out, conn->out + sent, conn->out_len);
     }
-    
-    wrefresh(session_win);
-    
-    // Wait for any key press
-    mvwprintw(session_win, height - 2, 1, "Press any key to continue...");
-    wrefresh(session_win);
-    getch();
-    
-    // Clean up
-    delwin(session_win);
-    display_screen();
+    return 1;
 }
 
-void display_help() {
-    if (help_win == NULL) {
-        return;
+void *server_worker(void *arg __attribute__((unused))) {
+    for (;;) {
+        struct epoll_event ready[SERVER_MAX_EVENTS];
+        int count = epoll_wait(server_epoll_fd, ready, SERVER_MAX_EVENTS, -1);
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.ptr == NULL) {
+                server_accept();
+                struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.ptr = NULL };
+                epoll_ctl(server_epoll_fd, EPOLL_CTL_MOD, server_listen_fd, &ev);
+            } else {
+                server_serve(ready[i].data.ptr);
+            }
+        }
     }
-    
-    // Clear help window
-    werase(help_win);
-    box(help_win, 0, 0);
-    
-    // Title
-    mvwprintw(help_win, 1, (getmaxx(help_win) - 20) / 2, "FOCUSFORGE HELP");
-    
-    // Help content
-    mvwprintw(help_win, 3, 2, "SESSION COMMANDS:");
-    mvwprintw(help_win, 4, 2, "a          - Start focus session");
-    mvwprintw(help_win, 5, 2, "f          - Start break session");
-    mvwprintw(help_win, 6, 2, "s          - Stop/pause session");
-    mvwprintw(help_win, 7, 2, "d          - Skip current session");
-    
-    mvwprintw(help_win, 9, 2, "TASK COMMANDS:");
-    mvwprintw(help_win, 10, 2, "Enter      - Add new task");
-    mvwprintw(help_win, 11, 2, "Space      - Set focus task");
-    mvwprintw(help_win, 12, 2, "j          - Mark task done");
-    mvwprintw(help_win, 13, 2, "k          - Unmark task");
-    mvwprintw(help_win, 14, 2, "l          - Remove task");
-    mvwprintw(help_win, 15, 2, "w/x        - Navigate tasks");
-    
-    mvwprintw(help_win, 17, 2, "OTHER:");
-    mvwprintw(help_win, 18, 2, "q          - Quit");
-    mvwprintw(help_win, 19, 2, "?          - Toggle help");
-    
-    mvwprintw(help_win, 21, 2, "TIPS:");
-    mvwprintw(help_win, 22, 2, "• Work 25 min, break 5 min");
-    mvwprintw(help_win, 23, 2, "• After 4 sessions, take");
-    mvwprintw(help_win, 24, 2, "  a longer break (15-30 min)");
-    mvwprintw(help_win, 25, 2, "• Stay focused on one task");
-    mvwprintw(help_win, 26, 2, "• Avoid distractions");
-    
-    wrefresh(help_win);
+    return NULL;
 }
 
-void initialize_directories() {
+// Serve until SIGINT or SIGTERM; signals are already blocked in every thread
+void run_server(const sigset_t *signals) {
     const char *home = getenv("HOME");
-    if (home == NULL) {
-        fprintf(stderr, "Error: HOME environment variable not set\n");
+    int ret = data_dir ? snprintf(server_root, sizeof(server_root), "%s", data_dir)
+                       : snprintf(server_root, sizeof(server_root), "%s/.focusforge/server", home ? home : ".");
+    if (ret < 0 || ret >= (int)sizeof(server_root) - SHARD_NAME_LEN - 16) {
+        fprintf(stderr, "Error: Path too long for server directory\n");
         exit(1);
     }
-    
-    int ret = snprintf(focusforge_dir, sizeof(focusforge_dir), "%s/.focusforge", home);
-    if (ret < 0 || ret >= (int)sizeof(focusforge_dir)) {
-        fprintf(stderr, "Error: Path too long for focusforge directory\n");
+    if (mkdir(server_root, 0711) == -1 && errno != EEXIST) {
+        fprintf(stderr, "Error creating directory %s: %s\n", server_root, strerror(errno));
         exit(1);
     }
     
-    ret = snprintf(tasks_file, sizeof(tasks_file), "%s/tasks.txt", focusforge_dir);
-    if (ret < 0 || ret >= (int)sizeof(tasks_file)) {
-        fprintf(stderr, "Error: Path too long for tasks file\n");
+    // The socket is set up as the daemon's is, in the server root
+    ret = snprintf(socket_file, sizeof(socket_file), "%s/server.sock", server_root);
+    server_listen_fd = ret < (int)sizeof(socket_file) ? daemon_listen(SOMAXCONN) : -1;
+    
+    // Open to every user on the machine; server_peer_account() decides who each one is
+    if (server_listen_fd != -1 && chmod(socket_file, 0666) == -1) {
+        perror("chmod");
+    }
+    server_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (server_listen_fd == -1) {
+        exit(1);  // daemon_listen() said why
+    }
+    if (server_epoll_fd == -1) {
+        perror("epoll_create1");
         exit(1);
     }
-    
-    ret = snprintf(sessions_file, sizeof(sessions_file), "%s/sessions.csv", focusforge_dir);
-    if (ret < 0 || ret >= (int)sizeof(sessions_file)) {
-        fprintf(stderr, "Error: Path too long for sessions file\n");
+    if (server_timer_fd == -1) {
+        perror("timerfd_create");
         exit(1);
     }
     
-    ret = snprintf(meta_file, sizeof(meta_file), "%s/meta", focusforge_dir);
-    if (ret < 0 || ret >= (int)sizeof(meta_file)) {
-        fprintf(stderr, "Error: Path too long for meta file\n");
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.ptr = NULL };
+    if (epoll_ctl(server_epoll_fd, EPOLL_CTL_ADD, server_listen_fd, &ev) == -1) {
+        perror("epoll_ctl");
         exit(1);
     }
+    wheel_init(&server_wheel, monotonic_ns());
     
-    ret = snprintf(settings_file, sizeof(settings_file), "%s/settings", focusforge_dir);
-    if (ret < 0 || ret >= (int)sizeof(settings_file)) {
-        fprintf(stderr, "Error: Path too long for settings file\n");
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, server_timer_thread, NULL) != 0) {
+        perror("pthread_create");
         exit(1);
     }
-    
-    // Create focusforge directory if it doesn't exist
-    struct stat st = {0};
-    if (stat(focusforge_dir, &st) == -1) {
-        if (mkdir(focusforge_dir, 0755) == -1) {
-            if (errno != EEXIST) {
-                fprintf(stderr, "Error creating directory %s: %s\n", focusforge_dir, strerror(errno));
-                exit(1);
-            }
+    int workers = server_workers > 0 ? server_workers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) {
+        workers = 1;
+    }
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&thread, NULL, server_worker, NULL) != 0) {
+            perror("pthread_create");
+            exit(1);
         }
     }
-    
-    // Create tasks.txt if it doesn't exist
-    FILE *fp = fopen(tasks_file, "a");
-    if (fp) {
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close tasks file");
+    fprintf(stderr, "FocusForge server on %s with %d workers\n", socket_file, workers);
+    
+    // Every event is written as it happens, so there is nothing to flush
+    int sig;
+    do {
+        sigwait(signals, &sig);
+    } while (sig == SIGWINCH);
+    unlink(socket_file);
+    fprintf(stderr, "Stopping: %ld users loaded\n", shard_count);
+    exit(0);
+}
+
+/* Load generator: BENCH_SERVER_USERS connections, one per user, spread over
+ * BENCH_SERVER_THREADS threads that each send a request, wait for the reply
+ * and move to their next connection. */
+void *bench_server_client(void *arg) {
+    BenchServerThread *self = arg;
+    unsigned seed = (unsigned)(self - bench_server_threads) + 1;
+    char request[MAX_INPUT_LEN];
+    char reply[256];
+    
+    while (monotonic_ns() < self->end_ns) {
+        for (int c = 0; c < self->conn_count && monotonic_ns() < self->end_ns; c++) {
+            int pick = rand_r(&seed) % 100;
+            int len;
+            if (pick < 40) {
+                len = snprintf(request, sizeof(request), "status\n");
+            } else if (pick < 60) {
+                len = snprintf(request, sizeof(request), "cmd a Task %d\n", rand_r(&seed) % 1000);
+            } else if (pick < 80) {
+                len = snprintf(request, sizeof(request), "cmd d %d\n", rand_r(&seed) % 20 + 1);
+            } else if (pick < 90) {
+                len = snprintf(request, sizeof(request), "cmd r %d\n", rand_r(&seed) % 20 + 1);
+            } else {
+                len = snprintf(request, sizeof(request), pick < 95 ? "cmd f\n" : "cmd s\n");
+            }
+            
+            long long t0 = monotonic_ns();
+            if (send(self->fds[c], request, len, MSG_NOSIGNAL) != len) {
+                self->errors++;
+                continue;
+            }
+            int got = 0;
+            while (got == 0 || reply[got - 1] != '\n') {
+                ssize_t n = recv(self->fds[c], reply + got, sizeof(reply) - got, 0);
+                if (n <= 0) {
+                    self->errors++;
+                    break;
+                }
+                got += n;
+                if (got == (int)sizeof(reply)) {
+                    got = 0;
+                }
+            }
+            long long took = monotonic_ns() - t0;
+            
+            if (self->sample_count < BENCH_SERVER_SAMPLES) {
+                self->samples[self->sample_count++] = took;
+            }
+            self->requests++;
         }
-    } else {
-        LOG_WARN("Failed to create tasks file");
     }
+    return NULL;
+}
+
+void bench_server() {
+    static char root[] = "/tmp/focusforge-server-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return;
+    }
+    data_dir = root;
     
-    // Create sessions.csv if it doesn't exist
-    fp = fopen(sessions_file, "a");
-    if (fp) {
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to create sessions file");
-        }
-    } else {
-        LOG_WARN("Failed to create sessions file");
+    pid_t server = fork();
+    if (server == -1) {
+        perror("fork");
+        return;
+    }
+    if (server == 0) {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGTERM);
+        sigprocmask(SIG_BLOCK, &signals, NULL);
+        run_server(&signals);
     }
     
-    // Create meta file if it doesn't exist with default values
-    fp = fopen(meta_file, "r");
-    if (!fp) {
-        fp = fopen(meta_file, "w");
-        if (fp) {
-            fprintf(fp, "streak_max=0\nstreak_current=0\n");
-            if (fclose(fp) != 0) {
-                LOG_WARN("Failed to close meta file");
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/server.sock", root);
+    safe_strncpy(socket_file, path, sizeof(socket_file));
+    
+    // Connect and select a user on every connection before the clock starts
+    int total = 0;
+    for (int t = 0; t < BENCH_SERVER_THREADS; t++) {
+        bench_server_threads[t].conn_count = 0;
+    }
+    for (int u = 0; u < BENCH_SERVER_USERS; u++) {
+        int fd = -1;
+        for (int attempt = 0; attempt < 200 && fd == -1; attempt++) {
+            fd = daemon_connect();
+            if (fd == -1) {
+                usleep(10000);
             }
-        } else {
-            LOG_WARN("Failed to create meta file");
         }
-    } else {
-        if (fclose(fp) != 0) {
-            LOG_WARN("Failed to close meta file");
+        if (fd == -1) {
+            fprintf(stderr, "Cannot connect to the server\n");
+            kill(server, SIGTERM);
+            return;
+        }
+        char request[64];
+        char reply[64];
+        int len = snprintf(request, sizeof(request), "user bench%03d\n", u);
+        if (send(fd, request, len, MSG_NOSIGNAL) != len || recv(fd, reply, sizeof(reply), 0) <= 0) {
+            fprintf(stderr, "Server did not answer\n");
+        }
+        BenchServerThread *owner = &bench_server_threads[u % BENCH_SERVER_THREADS];
+        owner->fds[owner->conn_count++] = fd;
+        total++;
+    }
+    
+    long long start = monotonic_ns();
+    pthread_t threads[BENCH_SERVER_THREADS];
+    for (int t = 0; t < BENCH_SERVER_THREADS; t++) {
+        bench_server_threads[t].end_ns = start + BENCH_SERVER_SECONDS * NS_PER_SEC;
+        pthread_create(&threads[t], NULL, bench_server_client, &bench_server_threads[t]);
+    }
+    
+    long requests = 0;
+    long errors = 0;
+    int sample_count = 0;
+    long long *samples = malloc(BENCH_SERVER_THREADS * BENCH_SERVER_SAMPLES * sizeof(long long));
+    for (int t = 0; t < BENCH_SERVER_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        requests += bench_server_threads[t].requests;
+        errors += bench_server_threads[t].errors;
+        if (samples != NULL) {
+            memcpy(samples + sample_count, bench_server_threads[t].samples,
+                   bench_server_threads[t].sample_count * sizeof(long long));
+            sample_count += bench_server_threads[t].sample_count;
         }
     }
+    double elapsed = (monotonic_ns() - start) / 1e9;
+    
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    
+    printf("%d users, %d client threads, %.1f s: %ld requests, %.0f req/s, %ld errors\n",
+           total, BENCH_SERVER_THREADS, elapsed, requests, requests / elapsed, errors);
+    if (samples != NULL && sample_count > 0) {
+        qsort(samples, sample_count, sizeof(long long), compare_long_long);
+        printf("latency p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+               samples[(long)sample_count * 50 / 100] / 1e3, samples[(long)sample_count * 99 / 100] / 1e3,
+               samples[(long)sample_count * 999 / 1000] / 1e3, samples[sample_count - 1] / 1e3);
+    }
+    printf("data in %s\n", root);
+    free(samples);
 }
 
-void free_resources() {
-    // Free any allocated resources
-    destroy_windows();
+/* --stress=N: N processes change one data directory at once through the
+ * usual event path, a few events per batch as a loop iteration writes
+ * them. Afterwards the log, the views and a fresh replay are checked
+ * against what they did. */
+void stress_instance(int id, int report_fd) {
+    headless = 1;
+    update_day_dates();
+    state_load();
+    
+    unsigned seed = (unsigned)getpid();
+    char text[MAX_INPUT_LEN];
+    long misses = 0;
+    for (int round = 0; round < STRESS_ROUNDS; round++) {
+        int batch = rand_r(&seed) % 3 + 1;
+        for (int b = 0; b < batch; b++) {
+            int pick = rand_r(&seed) % 4;
+            if (pick == 0 || num_tasks < 5) {
+                snprintf(text, sizeof(text), "Task %d.%d.%d", id, round, b);
+                state_emit(EV_TASK_ADD, 0, text);
+            } else {
+                // Name the task as the user would, by where it is shown before the lock
+                int index = rand_r(&seed) % num_tasks;
+                char meant[MAX_TASK_LEN];
+                safe_strncpy(meant, tasks[index].task, MAX_TASK_LEN);
+                index = task_pick(index);
+                if (index == -1) {
+                    continue;  // Removed by another instance in the meantime
+                }
+                StateEventType type = pick == 1 ? EV_TASK_DONE : pick == 2 ? EV_TASK_UNDONE : EV_TASK_REMOVE;
+                state_emit(type, index, "");
+                int hit = type == EV_TASK_REMOVE ? tasks_find(tasks, num_tasks, meant) == -1 :
+                          strcmp(tasks[index].task, meant) == 0 && tasks[index].done == (type == EV_TASK_DONE);
+                misses += !hit;
+            }
+        }
+        if (round % STRESS_SESSION_EVERY == 0) {
+            snprintf(text, sizeof(text), "%s,12:00,%d,\"Stress %d\"", today_date, FOCUS_DURATION, id);
+            state_emit(EV_SESSION_LOG, 0, text);
+        }
+        state_flush();
+    }
+    persist_stop();
+    
+    long report[2] = {events_lock_contended, misses};
+    if (write(report_fd, report, sizeof(report)) != sizeof(report)) {
+        _exit(1);
+    }
+    _exit(0);
 }
 
-void signal_handler(int sig __attribute__((unused))) {
-    // Just set the flag, don't do complex operations in signal handler
-    running = 0;
+int stress_check(int ok, const char *what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    return ok;
 }
 
-void cleanup_and_exit(int sig) {
-    // Save any pending data
-    save_tasks();
-    save_settings();
-    
-    // Free resources
-    free_resources();
+void run_stress(int instances) {
+    static char root[] = "/tmp/focusforge-stress-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    data_dir = root;
+    initialize_directories();
+    update_day_dates();
     
-    // End ncurses mode
-    endwin();
+    int report[2];
+    if (pipe(report) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+    long long start = monotonic_ns();
+    for (int i = 0; i < instances; i++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            close(report[0]);
+            stress_instance(i, report[1]);
+        }
+    }
+    close(report[1]);
     
-    // Exit with the signal number
-    exit(sig);
-}
-
-void resize_handler(int sig __attribute__((unused))) {
-    // Just set the flag to indicate resize is needed
-    resize_pending = 1;
-}
-
-void run_timer() {
-    // Main loop
-    while (running) {
-        // Check if resize is pending
-        if (resize_pending) {
-            handle_resize();
+    int failed_instances = 0;
+    int status;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed_instances++;
         }
-        
-        // Check if timer has expired
-        if (timer_seconds <= 0 && session_state != SESSION_INACTIVE) {
-            // Timer expired
-            if (session_state == SESSION_FOCUS) {
-                log_session();
-                session_state = SESSION_BREAK;
-                timer_seconds = BREAK_DURATION;
-                show_notification("Focus session completed! Break started.", 3);
-            } else if (session_state == SESSION_BREAK) {
-                session_state = SESSION_INACTIVE;
-                timer_seconds = FOCUS_DURATION;
-                show_notification("Break completed! Ready for next focus session.", 3);
-            }
+    }
+    double elapsed = (monotonic_ns() - start) / 1e9;
+    long contended = 0;
+    long misses = 0;
+    long counts[2];
+    while (read(report[0], counts, sizeof(counts)) == (ssize_t)sizeof(counts)) {
+        contended += counts[0];
+        misses += counts[1];
+    }
+    close(report[0]);
+    
+    // The log: one unbroken sequence, every session present once
+    long long expected_seq = 1;
+    int sequence_ok = 1;
+    int session_events = 0;
+    FILE *fp = fopen(events_file, "r");
+    char line[MAX_INPUT_LEN + 96];
+    StateEvent ev;
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        int parsed = state_parse_event(line, &ev);
+        if (!parsed || ev.seq != expected_seq) {
+            sequence_ok = 0;
         }
-        
-        // Update display
-        update_timer_display();
-        update_input_display();
-        
-        // Check for input (non-blocking)
-        timeout(1000);  // Wait 1 second for input
-        int ch = getch();
-        
-        if (ch == ERR) {
-            // No input, just decrement timer if active
-            if (session_state != SESSION_INACTIVE) {
-                timer_seconds--;
-            }
-        } else {
-            // Handle key input
-            handle_key_input(ch);
+        expected_seq++;
+        session_events += parsed && ev.type == EV_SESSION_LOG;
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    
+    int sessions_per_instance = (STRESS_ROUNDS + STRESS_SESSION_EVERY - 1) / STRESS_SESSION_EVERY;
+    int expected_sessions = instances * sessions_per_instance;
+    int csv_rows = 0;
+    fp = fopen(sessions_file, "r");
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        csv_rows++;
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    
+    int meta_streak = -1;
+    fp = fopen(meta_file, "r");
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "streak_current=", 15) == 0) {
+            meta_streak = atoi(line + 15);
         }
     }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    
+    // A fresh replay, from the snapshot the instances left, against the views
+    headless = 1;
+    state_load();
+    persist_stop();
+    Task on_disk[MAX_TASKS];
+    int on_disk_count = 0;
+    struct stat st;
+    uint32_t hash;
+    int tasks_ok = tasks_file_read(on_disk, &on_disk_count, &st, &hash) &&
+                   tasks_equal(on_disk, on_disk_count, tasks, num_tasks);
+    
+    long long events = expected_seq - 1;
+    printf("%d instances x %d batches: %lld events in %.2f s (%.0f events/s), lock contended %ld times\n",
+           instances, STRESS_ROUNDS, events, elapsed, events / elapsed, contended);
+    int ok = 1;
+    ok &= stress_check(failed_instances == 0, "every instance finished");
+    ok &= stress_check(sequence_ok, "events.log is one gapless sequence");
+    ok &= stress_check(session_events == expected_sessions, "every session logged once in events.log");
+    ok &= stress_check(csv_rows == expected_sessions, "sessions.csv has every session once");
+    ok &= stress_check(day_stats.sessions == expected_sessions, "today's count matches");
+    ok &= stress_check(streaks.streak_current == 1 && meta_streak == 1, "streak counted once in memory and meta");
+    ok &= stress_check(tasks_ok, "tasks.txt matches a replay of the log");
+    ok &= stress_check(misses == 0, "every done, undone and remove hit the task meant");
+    printf("data in %s\n", root);
+    exit(ok ? 0 : 1);
 }
 
 // Missing function implementations
 void show_notification(const char *message, int duration) {
+    if (headless) {
+        // The daemon tells the client that asked, or all of them for timer events
+        if (listen_fd != -1) {
+            char line[MAX_INPUT_LEN];
+            int len = snprintf(line, sizeof(line), "notify %d %s\n", duration, message);
+            if (len >= (int)sizeof(line)) {
+                len = sizeof(line) - 1;
+                line[len - 1] = '\n';
+            }
+            for (int i = 0; i < MAX_CLIENTS; i++) {
+                if (requesting_client == NULL || requesting_client == &clients[i]) {
+                    client_send(&clients[i], line, len);
+                }
+            }
+        }
+        if (sim_trace) {
+            time_t now = wall_time();
+            char stamp[32];
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+            printf("%s  %s\n", stamp, message);
+        }
+        return;
+    }
+    
     // Set notification end time
-    notification_end_time = time(NULL) + duration;
+    notification_end_ns = monotonic_ns() + duration * NS_PER_SEC;
+    timer_start(&timer_wheel, &notification_timer, notification_end_ns);
     
     // Create notification window
     int height = NOTIFICATION_HEIGHT;
@@ -1392,9 +5945,11 @@ void show_notification(const char *message, int duration) {
     }
     
     // Draw notification
-    box(notification_win, 0, 0);
+    frame_begin();
+    draw_border(notification_win);
     mvwprintw(notification_win, 1, 2, "%s", message);
-    wrefresh(notification_win);
+    wnoutrefresh(notification_win);
+    frame_end();
 }
 
 void show_notification_window(const char *message, int duration) {
@@ -1402,13 +5957,37 @@ void show_notification_window(const char *message, int duration) {
 }
 
 void process_input(char *input) {
+    // A daemon client runs quit and help itself and hands the rest over as typed
+    ParsedCommand cmd;
+    if (daemon_fd != -1 && parse_command_input(input, &cmd) && cmd.type != CMD_QUIT && cmd.type != CMD_HELP) {
+        forward_to_daemon("cmd %s", input);
+        return;
+    }
+    
     // Process the input command
     parse_command(input);
 }
 
 void display_screen() {
-    // Clear screen
-    clear();
+    if (headless) {
+        return;
+    }
+    
+    // Coalesce full redraws on slow links; redraw_timer flushes the pending one
+    long long now_ns = monotonic_ns();
+    if (low_bandwidth && now_ns - last_full_redraw_ns < LOW_BANDWIDTH_REDRAW_NS) {
+        if (!timer_pending(&redraw_timer)) {
+            timer_start(&timer_wheel, &redraw_timer, last_full_redraw_ns + LOW_BANDWIDTH_REDRAW_NS);
+        }
+        deferred_redraws++;
+        return;
+    }
+    timer_cancel(&timer_wheel, &redraw_timer);
+    last_full_redraw_ns = now_ns;
+    full_redraws++;
+    
+    // Erase rather than clear() so doupdate() only sends what changed
+    erase();
     
     // Get terminal dimensions
     int height, width;
@@ -1442,197 +6021,1061 @@ void display_screen() {
     int today_sessions = get_today_sessions_count();
     mvprintw(6, 2, "Streak: %d day(s) | Today: %d session(s)", streak, today_sessions);
     
-    // Display tasks
-    mvprintw(8, 2, "Tasks:");
-    for (int i = 0; i < num_tasks && i < height - 12; i++) {
-        const char *status = tasks[i].done ? "X" : " ";
-        const char *marker = (i == current_task_index) ? ">" : " ";
+    // Display tasks
+    mvprintw(8, 2, "Tasks:");
+    for (int i = 0; i < num_tasks && i < height - 12; i++) {
+        const char *status = tasks[i].done ? "X" : " ";
+        const char *marker = (i == current_task_index) ? ">" : " ";
+        
+        // Highlight current task
+        if (i == current_task_index) {
+            attron(A_REVERSE);
+        }
+        
+        mvprintw(9 + i, 4, "%s%d. [%s] %s", marker, i + 1, status, tasks[i].task);
+        
+        if (i == current_task_index) {
+            attroff(A_REVERSE);
+        }
+    }
+    
+    // Display help
+    mvprintw(height - 2, 2, "Press '?' for help, 'q' to quit");
+    
+    // Stage stdscr; the windows below are drawn on top of it
+    wnoutrefresh(stdscr);
+    
+    // Update all windows; erase() wiped the timer, so redraw it in full
+    timer_drawn_x = -1;
+    update_timer_display();
+    display_tasks();
+    if (show_help) {
+        display_help();
+    }
+    input_drawn_mode = -1;
+    update_input_display();
+    
+    // Keep a live notification on top of the freshly cleared screen
+    if (notification_win) {
+        touchwin(notification_win);
+        wnoutrefresh(notification_win);
+    }
+}
+
+void setup_windows() {
+    // Get terminal dimensions
+    int height, width;
+    getmaxyx(stdscr, height, width);
+    
+    // Create main window (full screen)
+    main_win = newwin(height, width, 0, 0);
+    
+    // Create timer window
+    int timer_height = 5;
+    int timer_width = 30;
+    int timer_y = 1;
+    int timer_x = (width - timer_width) / 2;
+    timer_win = newwin(timer_height, timer_width, timer_y, timer_x);
+    
+    // Create tasks window
+    int tasks_height = height - 10;
+    int tasks_width = width - 4;
+    int tasks_y = 7;
+    int tasks_x = 2;
+    tasks_win = newwin(tasks_height, tasks_width, tasks_y, tasks_x);
+    
+    // Create input window
+    int input_height = 3;
+    int input_width = width - 4;
+    int input_y = height - 4;
+    int input_x = 2;
+    input_win = newwin(input_height, input_width, input_y, input_x);
+    
+    // Create help window
+    int help_height = height - 4;
+    int help_width = HELP_WIDTH;
+    int help_y = 2;
+    int help_x = width - help_width - 2;
+    help_win = newwin(help_height, help_width, help_y, help_x);
+    if (help_win) {
+        draw_border(help_win);
+    }
+}
+
+void destroy_windows() {
+    if (main_win) {
+        delwin(main_win);
+        main_win = NULL;
+    }
+    
+    if (timer_win) {
+        delwin(timer_win);
+        timer_win = NULL;
+    }
+    
+    if (tasks_win) {
+        delwin(tasks_win);
+        tasks_win = NULL;
+    }
+    
+    if (input_win) {
+        delwin(input_win);
+        input_win = NULL;
+    }
+    
+    if (help_win) {
+        delwin(help_win);
+        help_win = NULL;
+    }
+    
+    if (help_pad) {
+        delwin(help_pad);
+        help_pad = NULL;
+    }
+    
+    if (notification_win) {
+        delwin(notification_win);
+        notification_win = NULL;
+    }
+    
+    if (overlay_win) {
+        delwin(overlay_win);
+        overlay_win = NULL;
+    }
+}
+
+void handle_resize() {
+    // SIGWINCH arrives through signalfd, so tell ncurses the new size ourselves
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        resizeterm(ws.ws_row, ws.ws_col);
+    }
+    
+    // Destroy existing windows
+    destroy_windows();
+    
+    // Terminal contents are unknown after a resize: repaint everything once
+    clearok(curscr, TRUE);
+    
+    // Setup new windows
+    setup_windows();
+    
+    // Redisplay screen
+    display_screen();
+    views_resize();
+}
+
+void update_timer_display() {
+    if (timer_win == NULL) {
+        return;
+    }
+    
+    char time_str[10];
+    format_time(timer_seconds, time_str);
+    
+    const char *symbol;
+    if (session_state == SESSION_FOCUS) {
+        symbol = FOCUS_SYMBOLS;
+    } else if (session_state == SESSION_BREAK) {
+        symbol = BREAK_SYMBOLS;
+    } else {
+        symbol = READY_SYMBOLS;
+    }
+    
+    char text[TIMER_TEXT_LEN];
+    snprintf(text, sizeof(text), "%s %s]", symbol, time_str);
+    int len = strlen(text);
+    int x = (getmaxx(timer_win) - len) / 2;
+    
+    if (x != timer_drawn_x || len != (int)strlen(timer_drawn)) {
+        // Layout changed or window was cleared: draw everything
+        werase(timer_win);
+        draw_border(timer_win);
+        mvwprintw(timer_win, 2, x, "%s", text);
+    } else {
+        // Once-per-second tick: touch only the digits that changed
+        int changed = 0;
+        for (int i = 0; i < len; i++) {
+            if (text[i] != timer_drawn[i]) {
+                mvwaddch(timer_win, 2, x + i, text[i]);
+                changed = 1;
+            }
+        }
+        if (!changed) {
+            return;
+        }
+    }
+    
+    safe_strncpy(timer_drawn, text, sizeof(timer_drawn));
+    timer_drawn_x = x;
+    wnoutrefresh(timer_win);
+}
+
+void update_input_display() {
+    if (input_win == NULL) {
+        return;
+    }
+    
+    int full = (input_mode != input_drawn_mode);
+    if (full) {
+        werase(input_win);
+        draw_border(input_win);
+        input_drawn_mode = input_mode;
+        if (!input_mode) {
+            mvwprintw(input_win, 1, 1, "%s", INPUT_HINT);
+            wnoutrefresh(input_win);
+            return;
+        }
+        mvwprintw(input_win, 1, 1, "%s", INPUT_PROMPT);
+    } else if (!input_mode) {
+        return;
+    }
+    
+    // Field runs from after the prompt up to the right border
+    int field_x = 1 + strlen(INPUT_PROMPT) + 1;
+    int field_width = getmaxx(input_win) - 1 - field_x;
+    if (field_width < 2) {
+        field_width = 2;
+    }
+    
+    // Keep the cursor cell inside the field, scrolling half a field at a time
+    int scroll = input_scroll;
+    if (input_pos - scroll >= field_width) {
+        scroll = input_pos - field_width / 2;
+    } else if (input_pos <= scroll && scroll > 0) {
+        scroll = input_pos > field_width / 2 ? input_pos - field_width / 2 : 0;
+    }
+    
+    int shown = input_pos - scroll;
+    if (full || scroll != input_scroll) {
+        // Window was cleared or the text scrolled: redraw the visible slice
+        mvwaddch(input_win, 1, field_x - 1, scroll > 0 ? '<' : ' ');
+        mvwprintw(input_win, 1, field_x, "%-*.*s", field_width, shown, input_buffer + scroll);
+        input_scroll = scroll;
+    } else if (shown > input_drawn_len) {
+        // Typed characters: append only the new cells
+        for (int i = input_drawn_len; i < shown; i++) {
+            mvwaddch(input_win, 1, field_x + i, input_buffer[scroll + i]);
+        }
+    } else if (shown < input_drawn_len) {
+        // Backspace: blank only the removed cells
+        for (int i = shown; i < input_drawn_len; i++) {
+            mvwaddch(input_win, 1, field_x + i, ' ');
+        }
+    } else {
+        return;
+    }
+    
+    input_drawn_len = shown;
+    wnoutrefresh(input_win);
+}
+
+time_t wall_time() {
+    return active_clock->wall();
+}
+
+long long monotonic_ns() {
+    return active_clock->monotonic();
+}
+
+long long boottime_ns() {
+    return active_clock->boottime();
+}
+
+time_t system_wall_time() {
+    return time(NULL);
+}
+
+long long system_monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+long long system_boottime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (long long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+time_t virtual_wall_time() {
+    return (time_t)(virtual_wall_ns / NS_PER_SEC);
+}
+
+long long virtual_monotonic_ns() {
+    return virtual_mono_ns;
+}
+
+long long virtual_boottime_ns() {
+    return virtual_boot_ns;
+}
+
+// Whole seconds left until deadline, rounded up so 24:59.2 shows as 25:00
+int remaining_seconds(long long deadline_ns, long long now_ns) {
+    long long left = deadline_ns - now_ns;
+    if (left <= 0) {
+        return 0;
+    }
+    return (int)((left + NS_PER_SEC - 1) / NS_PER_SEC);
+}
+
+// Time the current phase has actually run: CLOCK_MONOTONIC skips suspend, so
+// only gaps counted by SUSPEND_COUNT are added back. Never runs past the deadline.
+long long session_active_ns() {
+    long long end = monotonic_ns();
+    if (end > session_deadline_ns) {
+        end = session_deadline_ns;
+    }
+    
+    long long active = end - session_start_mono_ns + session_counted_gap_ns;
+    return active > 0 ? active : 0;
+}
+
+int session_active_seconds() {
+    return (int)((session_active_ns() + NS_PER_SEC / 2) / NS_PER_SEC);
+}
+
+/* CLOCK_BOOTTIME keeps running through suspend while CLOCK_MONOTONIC stops,
+ * so growth in their difference is exactly the time spent asleep. */
+void check_suspend_gap() {
+    long long offset = boottime_ns() - monotonic_ns();
+    long long gap = offset - suspend_offset_ns;
+    suspend_offset_ns = offset;
+    
+    if (gap < SUSPEND_MIN_GAP_NS) {
+        return;
+    }
+    
+    // CLOCK_MONOTONIC stood still, so a midnight slept through has not fired
+    day_rollover();
+    if (session_state == SESSION_INACTIVE) {
+        return;
+    }
+    
+    char message[64];
+    if (suspend_policy == SUSPEND_COUNT) {
+        session_deadline_ns -= gap;
+        session_counted_gap_ns += gap;
+        schedule_phase();
+        snprintf(message, sizeof(message), "Counted %lld min of suspend", gap / (60 * NS_PER_SEC));
+    } else if (suspend_policy == SUSPEND_END) {
+        end_session();
+        snprintf(message, sizeof(message), "Session ended at suspend");
+    } else {
+        snprintf(message, sizeof(message), "Session paused during suspend");
+    }
+    show_notification(message, 3);
+}
+
+// Absolute time at which remaining_seconds() next changes
+long long next_tick_ns(long long deadline_ns, long long now_ns) {
+    long long left = deadline_ns - now_ns;
+    if (left <= 0) {
+        return now_ns;
+    }
+    return deadline_ns - ((left - 1) / NS_PER_SEC) * NS_PER_SEC;
+}
+
+/* Simulate an hour-long timer with keypresses arriving every 0.1-2 s and
+ * 2 ms of processing per wakeup, comparing the old decrement-on-timeout
+ * loop against the deadline loop. Prints the displayed seconds left at the
+ * moment the hour has truly elapsed; the deadline loop must show 0. */
+void bench_timer_drift() {
+    const long long hour_ns = 3600 * NS_PER_SEC;
+    const long long work_ns = 2000000;
+    
+    for (int pass = 0; pass < 2; pass++) {
+        srand(1);
+        long long now = 0;
+        long long next_key = 0;
+        long long wakeups = 0;
+        int shown = 3600;
         
-        // Highlight current task
-        if (i == current_task_index) {
-            attron(A_REVERSE);
+        while (now < hour_ns) {
+            next_key = now + 100000000LL + (rand() % 1900) * 1000000LL;
+            long long wait = pass == 0 ? NS_PER_SEC : next_tick_ns(hour_ns, now) - now;
+            
+            if (next_key < now + wait) {
+                now = next_key;  // Key arrives before the timeout
+            } else {
+                now += wait;
+                if (pass == 0 && shown > 0) {
+                    shown--;
+                }
+            }
+            now += work_ns;
+            wakeups++;
+            
+            if (pass == 1) {
+                shown = remaining_seconds(hour_ns, now);
+            }
         }
         
-        mvprintw(9 + i, 4, "%s%d. [%s] %s", marker, i + 1, status, tasks[i].task);
-        
-        if (i == current_task_index) {
-            attroff(A_REVERSE);
-        }
+        printf("%-9s wakeups %-6lld displayed at 60:00 elapsed: %d s left (error %+d s)\n",
+               pass == 0 ? "countdown" : "deadline", wakeups, shown, shown);
+    }
+}
+
+// Bytes this thread has passed to write(2); 0 when /proc is unavailable.
+// ncurses writes straight to the terminal fd, so the delta around doupdate()
+// is exactly what the frame cost on the wire.
+unsigned long thread_bytes_written() {
+    if (thread_io_fd < 0) {
+        return 0;
     }
     
-    // Display help
-    mvprintw(height - 2, 2, "Press '?' for help, 'q' to quit");
+    char buf[512];
+    ssize_t len = pread(thread_io_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) {
+        return 0;
+    }
+    buf[len] = '\0';
     
-    // Refresh screen
-    refresh();
+    char *field = strstr(buf, "wchar:");
+    return field ? strtoul(field + 6, NULL, 10) : 0;
+}
+
+void frame_begin() {
+    if (headless || frame_depth++ > 0) {
+        return;
+    }
     
-    // Update all windows
-    update_timer_display();
-    display_tasks();
-    if (show_help) {
-        display_help();
+    frame_start_ns = monotonic_ns();
+}
+
+// Commit everything staged since frame_begin() with a single doupdate()
+void frame_end() {
+    if (frame_depth == 0 || --frame_depth > 0) {
+        return;
     }
-    update_input_display();
     
-    // Check if notification should be hidden
-    if (notification_win && time(NULL) >= notification_end_time) {
-        delwin(notification_win);
-        notification_win = NULL;
+    // Views, then a live notification, stay above whatever this frame redrew
+    views_stage();
+    if (view_count > 0 && notification_win) {
+        touchwin(notification_win);
+        wnoutrefresh(notification_win);
+    }
+    if (show_overlay) {
+        display_overlay();
+    }
+    
+    long long built = monotonic_ns();
+    unsigned long before = thread_bytes_written();
+    doupdate();
+    unsigned long sent = thread_bytes_written() - before;
+    long long painted = monotonic_ns();
+    
+    tty_bytes_written += sent;
+
+    int slot = frame_stats.head;
+    frame_stats.build_ns[slot] = built - frame_start_ns;
+    frame_stats.update_ns[slot] = painted - built;
+    frame_stats.bytes[slot] = (long)sent;
+    frame_stats.head = (slot + 1) % FRAME_SAMPLES;
+    if (frame_stats.count < FRAME_SAMPLES) {
+        frame_stats.count++;
+    }
+    frame_stats.frames++;
+    
+    if (frame_stats.key_pending_ns > 0) {
+        if (frame_stats.latency_count < LATENCY_SAMPLES) {
+            frame_stats.latency_ns[frame_stats.latency_count++] = painted - frame_stats.key_pending_ns;
+        }
+        histogram_observe(&metrics.keypress_latency, painted - frame_stats.key_pending_ns);
+        frame_stats.key_pending_ns = 0;
     }
 }
 
-void setup_windows() {
-    // Get terminal dimensions
-    int height, width;
-    getmaxyx(stdscr, height, width);
+void frame_key_received() {
+    if (frame_stats.key_pending_ns == 0) {
+        frame_stats.key_pending_ns = monotonic_ns();
+    }
+}
+
+int compare_long_long(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile (0-100) of the first count samples; sorts a private copy
+long long percentile_ns(const long long *samples, int count, int pct) {
+    static long long sorted[LATENCY_SAMPLES];
+    if (count <= 0) {
+        return 0;
+    }
     
-    // Create main window (full screen)
-    main_win = newwin(height, width, 0, 0);
+    memcpy(sorted, samples, count * sizeof(long long));
+    qsort(sorted, count, sizeof(long long), compare_long_long);
     
-    // Create timer window
-    int timer_height = 5;
-    int timer_width = 30;
-    int timer_y = 1;
-    int timer_x = (width - timer_width) / 2;
-    timer_win = newwin(timer_height, timer_width, timer_y, timer_x);
+    int idx = (count * pct) / 100;
+    if (idx >= count) {
+        idx = count - 1;
+    }
+    return sorted[idx];
+}
+
+void display_overlay() {
+    if (overlay_win == NULL) {
+        overlay_win = newwin(OVERLAY_HEIGHT, OVERLAY_WIDTH, 1, 1);
+        if (overlay_win == NULL) {
+            return;
+        }
+    }
     
-    // Create tasks window
-    int tasks_height = height - 10;
-    int tasks_width = width - 4;
-    int tasks_y = 7;
-    int tasks_x = 2;
-    tasks_win = newwin(tasks_height, tasks_width, tasks_y, tasks_x);
+    int last = (frame_stats.head + FRAME_SAMPLES - 1) % FRAME_SAMPLES;
+    int count = frame_stats.count;
     
-    // Create input window
-    int input_height = 3;
-    int input_width = width - 4;
-    int input_y = height - 4;
-    int input_x = 2;
-    input_win = newwin(input_height, input_width, input_y, input_x);
+    werase(overlay_win);
+    draw_border(overlay_win);
+    mvwprintw(overlay_win, 0, 2, " frame %lld ", frame_stats.frames);
+    if (count == 0) {
+        wnoutrefresh(overlay_win);
+        return;
+    }
     
-    // Create help window
-    int help_height = height - 4;
-    int help_width = HELP_WIDTH;
-    int help_y = 2;
-    int help_x = width - help_width - 2;
-    help_win = newwin(help_height, help_width, help_y, help_x);
+    mvwprintw(overlay_win, 1, 2, "last  build %6.2fms  update %6.2fms %5ldB",
+              frame_stats.build_ns[last] / 1e6, frame_stats.update_ns[last] / 1e6,
+              frame_stats.bytes[last]);
+    mvwprintw(overlay_win, 2, 2, "p50   build %6.2fms  update %6.2fms",
+              percentile_ns(frame_stats.build_ns, count, 50) / 1e6,
+              percentile_ns(frame_stats.update_ns, count, 50) / 1e6);
+    mvwprintw(overlay_win, 3, 2, "p99   build %6.2fms  update %6.2fms",
+              percentile_ns(frame_stats.build_ns, count, 99) / 1e6,
+              percentile_ns(frame_stats.update_ns, count, 99) / 1e6);
+    mvwprintw(overlay_win, 4, 2, "key->paint p50 %6.2fms  tty %luB",
+              percentile_ns(frame_stats.latency_ns, frame_stats.latency_count, 50) / 1e6,
+              tty_bytes_written);
+    mvwprintw(overlay_win, 5, 2, "wakeups/min %-5d total %lld",
+              wakeups_last_minute(), wakeups_total);
+    
+    wnoutrefresh(overlay_win);
 }
 
-void destroy_windows() {
-    if (main_win) {
-        delwin(main_win);
-        main_win = NULL;
+// Called after endwin() so the report lands on the normal terminal
+void dump_frame_stats() {
+    if (latency_dump_file != NULL) {
+        FILE *fp = fopen(latency_dump_file, "w");
+        if (fp) {
+            for (int i = 0; i < frame_stats.latency_count; i++) {
+                fprintf(fp, "%lld\n", frame_stats.latency_ns[i] / 1000);
+            }
+            if (fclose(fp) != 0) {
+                LOG_WARN("Failed to close latency dump file");
+            }
+        } else {
+            LOG_ERROR("Failed to open latency dump file");
+        }
     }
     
-    if (timer_win) {
-        delwin(timer_win);
-        timer_win = NULL;
+    if (!frame_stats_on_exit) {
+        return;
     }
     
-    if (tasks_win) {
-        delwin(tasks_win);
-        tasks_win = NULL;
+    int count = frame_stats.count;
+    int keys = frame_stats.latency_count;
+    fprintf(stderr, "frames:      %lld (last %d sampled)\n", frame_stats.frames, count);
+    fprintf(stderr, "build:       p50 %.3fms  p99 %.3fms\n",
+            percentile_ns(frame_stats.build_ns, count, 50) / 1e6,
+            percentile_ns(frame_stats.build_ns, count, 99) / 1e6);
+    fprintf(stderr, "doupdate:    p50 %.3fms  p99 %.3fms\n",
+            percentile_ns(frame_stats.update_ns, count, 50) / 1e6,
+            percentile_ns(frame_stats.update_ns, count, 99) / 1e6);
+    fprintf(stderr, "tty bytes:   %lu\n", tty_bytes_written);
+    fprintf(stderr, "key->paint:  %d keys  p50 %.3fms  p99 %.3fms  max %.3fms\n", keys,
+            percentile_ns(frame_stats.latency_ns, keys, 50) / 1e6,
+            percentile_ns(frame_stats.latency_ns, keys, 99) / 1e6,
+            percentile_ns(frame_stats.latency_ns, keys, 100) / 1e6);
+}
+
+// Borders are cosmetic; skip them when every byte counts
+void draw_border(WINDOW *win) {
+    if (!low_bandwidth) {
+        box(win, 0, 0);
+    }
+}
+
+// Must run after initscr() so the terminal speed is known
+void detect_low_bandwidth() {
+    const char *env = getenv("FOCUSFORGE_LOW_BANDWIDTH");
+    if (env != NULL && env[0] != '\0') {
+        low_bandwidth = strcmp(env, "0") != 0;
+    } else if (!low_bandwidth) {
+        int speed = baudrate();
+        low_bandwidth = speed > 0 && speed <= LOW_BANDWIDTH_BAUD;
     }
     
-    if (input_win) {
-        delwin(input_win);
-        input_win = NULL;
+    if (low_bandwidth) {
+        show_help = 0;  // Still available with 'h'
+    }
+}
+
+void dump_render_stats() {
+    if (!render_stats_on_exit) {
+        return;
     }
     
-    if (help_win) {
-        delwin(help_win);
-        help_win = NULL;
+    double minutes = (monotonic_ns() - render_start_ns) / 60e9;
+    fprintf(stderr, "render mode:   %s\n", low_bandwidth ? "low-bandwidth" : "normal");
+    fprintf(stderr, "tty bytes:     %lu in %.1f min\n", tty_bytes_written, minutes);
+    fprintf(stderr, "bytes/minute:  %.0f\n", minutes > 0 ? tty_bytes_written / minutes : 0.0);
+    fprintf(stderr, "full redraws:  %ld (%ld deferred)\n", full_redraws, deferred_redraws);
+    fprintf(stderr, "wakeups:       %lld (%.1f/min, %d in the last minute)\n", wakeups_total,
+            minutes > 0 ? wakeups_total / minutes : 0.0, wakeups_last_minute());
+}
+
+// Durations like 25m, 1h30m or 2d; -1 if malformed
+long long sim_parse_duration(const char *text) {
+    long long total = 0;
+    const char *p = text;
+    if (*p == '\0') {
+        return -1;
     }
     
-    if (notification_win) {
-        delwin(notification_win);
-        notification_win = NULL;
+    while (*p != '\0') {
+        char *end;
+        errno = 0;
+        long long n = strtoll(p, &end, 10);
+        if (end == p || errno != 0 || n < 0) {
+            return -1;
+        }
+        
+        switch (*end) {
+            case 'd': total += n * 86400 * NS_PER_SEC; break;
+            case 'h': total += n * 3600 * NS_PER_SEC; break;
+            case 'm': total += n * 60 * NS_PER_SEC; break;
+            case 's': total += n * NS_PER_SEC; break;
+            default: return -1;
+        }
+        p = end + 1;
     }
+    return total;
 }
 
-void handle_resize() {
-    // Clear resize flag
-    resize_pending = 0;
-    
-    // Destroy existing windows
-    destroy_windows();
+// Run the machine forward, stopping at every wheel slot so callbacks see their exact due time
+void sim_advance(long long delta_ns) {
+    long long target = virtual_mono_ns + delta_ns;
+    long long due;
+    
+    while ((due = wheel_next_expiry_ns(&timer_wheel)) >= 0 && due <= target) {
+        if (due > virtual_mono_ns) {
+            virtual_wall_ns += due - virtual_mono_ns;
+            virtual_boot_ns += due - virtual_mono_ns;
+            virtual_mono_ns = due;
+        }
+        wheel_advance(&timer_wheel, virtual_mono_ns);
+    }
     
-    // Setup new windows
-    setup_windows();
+    virtual_wall_ns += target - virtual_mono_ns;
+    virtual_boot_ns += target - virtual_mono_ns;
+    virtual_mono_ns = target;
+    wheel_advance(&timer_wheel, virtual_mono_ns);
     
-    // Redisplay screen
-    display_screen();
+    if (session_state != SESSION_INACTIVE) {
+        timer_seconds = remaining_seconds(session_deadline_ns, virtual_mono_ns);
+    }
 }
 
-void update_timer_display() {
-    if (timer_win == NULL) {
-        return;
+// Sleep the machine: wall and boot time move on, CLOCK_MONOTONIC does not
+void sim_suspend(long long gap_ns) {
+    virtual_wall_ns += gap_ns;
+    virtual_boot_ns += gap_ns;
+    check_suspend_gap();
+    sim_advance(0);
+}
+
+/* Run script lines [first, last). Returns 0 on a script error.
+ *
+ *   tz ZONE               set TZ, e.g. Europe/Helsinki
+ *   at YYYY-MM-DD HH:MM   set the wall clock (local time) without running timers
+ *   advance 1h30m         let time pass, firing timers as they come due
+ *   until HH:MM           advance to the next local HH:MM
+ *   suspend 8h            sleep the machine, then reconcile as on wakeup
+ *   policy pause|count|end
+ *   key a | Enter | Space | Esc     press a key
+ *   cmd TEXT              run TEXT as if typed after Enter
+ *   repeat N ... end      run the enclosed lines N times
+ *   expect state|remaining|today|streak|logged|tasks VALUE
+ *   print                 date, state, countdown, today and streak
+ *   trace on|off          echo notifications with their virtual time */
+int sim_run(char **lines, int first, int last) {
+    for (int i = first; i < last && running; i++) {
+        char *line = lines[i];
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+        
+        char word[32] = "";
+        int used = 0;
+        sscanf(line, "%31s %n", word, &used);
+        char *arg = line + used;
+        
+        if (strcmp(word, "repeat") == 0) {
+            int depth = 1;
+            int end = i + 1;
+            for (; end < last; end++) {
+                char first_word[32] = "";
+                sscanf(lines[end], "%31s", first_word);
+                if (strcmp(first_word, "repeat") == 0) {
+                    depth++;
+                } else if (strcmp(first_word, "end") == 0 && --depth == 0) {
+                    break;
+                }
+            }
+            if (end == last) {
+                fprintf(stderr, "%s:%d: repeat without end\n", simulate_script, i + 1);
+                return 0;
+            }
+            for (long n = atol(arg); n > 0; n--) {
+                if (!sim_run(lines, i + 1, end)) {
+                    return 0;
+                }
+            }
+            i = end;
+        } else if (strcmp(word, "tz") == 0) {
+            setenv("TZ", arg, 1);
+            tzset();
+            day_rollover();
+        } else if (strcmp(word, "at") == 0) {
+            struct tm tm = {0};
+            if (sscanf(arg, "%d-%d-%d %d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                       &tm.tm_hour, &tm.tm_min) != 5) {
+                fprintf(stderr, "%s:%d: expected YYYY-MM-DD HH:MM\n", simulate_script, i + 1);
+                return 0;
+            }
+            tm.tm_year -= 1900;
+            tm.tm_mon -= 1;
+            tm.tm_isdst = -1;
+            virtual_wall_ns = (long long)mktime(&tm) * NS_PER_SEC;
+            day_rollover();  // As after any change of the system time
+        } else if (strcmp(word, "advance") == 0 || strcmp(word, "suspend") == 0) {
+            long long delta = sim_parse_duration(arg);
+            if (delta < 0) {
+                fprintf(stderr, "%s:%d: bad duration '%s'\n", simulate_script, i + 1, arg);
+                return 0;
+            }
+            if (word[0] == 'a') {
+                sim_advance(delta);
+            } else {
+                sim_suspend(delta);
+            }
+        } else if (strcmp(word, "until") == 0) {
+            time_t now = wall_time();
+            struct tm tm = *localtime(&now);
+            if (sscanf(arg, "%d:%d", &tm.tm_hour, &tm.tm_min) != 2) {
+                fprintf(stderr, "%s:%d: expected HH:MM\n", simulate_script, i + 1);
+                return 0;
+            }
+            tm.tm_sec = 0;
+            tm.tm_isdst = -1;
+            time_t at = mktime(&tm);
+            if (at <= now) {
+                tm.tm_mday++;
+                tm.tm_isdst = -1;
+                at = mktime(&tm);
+            }
+            sim_advance(((long long)at - now) * NS_PER_SEC - virtual_wall_ns % NS_PER_SEC);
+        } else if (strcmp(word, "policy") == 0) {
+            for (int p = SUSPEND_PAUSE; p <= SUSPEND_END; p++) {
+                if (strcmp(arg, suspend_policy_names[p]) == 0) {
+                    suspend_policy = p;
+                }
+            }
+        } else if (strcmp(word, "key") == 0) {
+            int ch = strcmp(arg, "Enter") == 0 ? '\n' : strcmp(arg, "Space") == 0 ? ' ' :
+                     strcmp(arg, "Esc") == 0 ? 27 : arg[0];
+            handle_key_input(ch);
+        } else if (strcmp(word, "cmd") == 0) {
+            process_input(arg);
+        } else if (strcmp(word, "trace") == 0) {
+            sim_trace = strcmp(arg, "off") != 0;
+        } else if (strcmp(word, "expect") == 0 || strcmp(word, "print") == 0) {
+            const char *state = session_state == SESSION_FOCUS ? "focus" :
+                                session_state == SESSION_BREAK ? "break" : "ready";
+            char countdown[10];
+            format_time(timer_seconds, countdown);
+            
+            if (word[0] == 'p') {
+                time_t now = wall_time();
+                char stamp[32];
+                strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M %Z", localtime(&now));
+                printf("%s  %s %s  today %d  streak %d\n", stamp, state, countdown,
+                       get_today_sessions_count(), get_current_streak());
+                continue;
+            }
+            
+            char what[32] = "";
+            char want[64] = "";
+            sscanf(arg, "%31s %63s", what, want);
+            char got[64];
+            if (strcmp(what, "state") == 0) {
+                snprintf(got, sizeof(got), "%s", state);
+            } else if (strcmp(what, "remaining") == 0) {
+                snprintf(got, sizeof(got), "%s", countdown);
+            } else if (strcmp(what, "today") == 0) {
+                snprintf(got, sizeof(got), "%d", get_today_sessions_count());
+            } else if (strcmp(what, "streak") == 0) {
+                snprintf(got, sizeof(got), "%d", get_current_streak());
+            } else if (strcmp(what, "logged") == 0) {
+                snprintf(got, sizeof(got), "%ld", sessions_logged);
+            } else if (strcmp(what, "tasks") == 0) {
+                snprintf(got, sizeof(got), "%d", num_tasks);
+            } else {
+                fprintf(stderr, "%s:%d: cannot expect '%s'\n", simulate_script, i + 1, what);
+                return 0;
+            }
+            if (strcmp(got, want) != 0) {
+                fprintf(stderr, "%s:%d: expected %s %s, got %s\n", simulate_script, i + 1, what, want, got);
+                sim_failures++;
+            }
+        } else {
+            fprintf(stderr, "%s:%d: unknown command '%s'\n", simulate_script, i + 1, word);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Headless run against a virtual clock. Nothing waits on real time, so a
+ * year of sessions takes seconds; the data directory is a fresh temporary
+ * one unless --data-dir is given. Exits 1 if any 'expect' failed. */
+void run_simulation(const char *script) {
+    FILE *fp = strcmp(script, "-") == 0 ? stdin : fopen(script, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open %s: %s\n", script, strerror(errno));
+        exit(2);
     }
     
-    werase(timer_win);
-    box(timer_win, 0, 0);
-    
-    char time_str[10];
-    format_time(timer_seconds, time_str);
+    char **lines = NULL;
+    int count = 0;
+    int capacity = 0;
+    char buf[MAX_INPUT_LEN];
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+        buf[strcspn(buf, "\r\n")] = '\0';
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char **grown = realloc(lines, capacity * sizeof(char *));
+            if (grown == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(2);
+            }
+            lines = grown;
+        }
+        lines[count++] = strdup(buf);
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
     
-    const char *symbol;
-    if (session_state == SESSION_FOCUS) {
-        symbol = FOCUS_SYMBOLS;
-    } else if (session_state == SESSION_BREAK) {
-        symbol = BREAK_SYMBOLS;
-    } else {
-        symbol = READY_SYMBOLS;
+    static char temp_dir[] = "/tmp/focusforge-sim-XXXXXX";
+    if (data_dir == NULL) {
+        if (mkdtemp(temp_dir) == NULL) {
+            perror("mkdtemp");
+            exit(2);
+        }
+        data_dir = temp_dir;
     }
     
-    mvwprintw(timer_win, 2, (getmaxx(timer_win) - strlen(time_str) - strlen(symbol) - 3) / 2, 
-              "%s %s]", symbol, time_str);
+    headless = 1;
+    active_clock = &virtual_clock;
+    virtual_wall_ns = (long long)time(NULL) * NS_PER_SEC;
     
-    wrefresh(timer_win);
+    initialize_directories();
+    load_settings();
+    state_load();
+    timers_init(virtual_mono_ns);
+    suspend_offset_ns = virtual_boot_ns - virtual_mono_ns;
+    day_rollover();
+    
+    long long t0 = system_monotonic_ns();
+    int ok = sim_run(lines, 0, count);
+    state_flush();
+    persist_stop();
+    double elapsed = (system_monotonic_ns() - t0) / 1e9;
+    
+    fprintf(stderr, "simulated %.1f days in %.3f s: %ld sessions logged (%.1f us each), data in %s\n",
+            virtual_mono_ns / (86400.0 * NS_PER_SEC), elapsed, sessions_logged,
+            sessions_logged ? elapsed * 1e6 / sessions_logged : 0.0, data_dir);
+    
+    for (int i = 0; i < count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    exit(!ok ? 2 : sim_failures ? 1 : 0);
 }
 
-void update_input_display() {
-    if (input_win == NULL) {
-        return;
+/* --status: print the status page and exit. Status bars run this every
+ * second in every pane, so it touches nothing but the page: no ncurses,
+ * no directory setup, no log or sessions.csv reading. */
+int run_status_query(const char *format) {
+    char path[MAX_PATH_LEN];
+    const char *home = getenv("HOME");
+    int ret = data_dir ? snprintf(path, sizeof(path), "%s/status", data_dir)
+                       : snprintf(path, sizeof(path), "%s/.focusforge/status", home ? home : "");
+    if (ret < 0 || ret >= (int)sizeof(path)) {
+        fprintf(stderr, "Error: Path too long for status file\n");
+        return 1;
+    }
+    
+    StatusPage page;
+    int found = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        void *map = mmap(NULL, sizeof(StatusPage), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map != MAP_FAILED) {
+            found = status_read(map, &page);
+            munmap(map, sizeof(StatusPage));
+        }
+    }
+    
+    // A page nobody keeps current is only good for the day it was written
+    int live = found && page.pid > 0 && (kill(page.pid, 0) == 0 || errno != ESRCH);
+    if (found && !live) {
+        update_day_dates();
+        if (strcmp(page.date, today_date) != 0) {
+            page.today_sessions = 0;
+            if (strcmp(page.date, yesterday_date) != 0) {
+                page.streak = 0;
+            }
+        }
     }
     
-    werase(input_win);
-    box(input_win, 0, 0);
+    const char *phase = "off";
+    int left = -1;
+    if (live) {
+        phase = page.state == SESSION_FOCUS ? "focus" : page.state == SESSION_BREAK ? "break" : "ready";
+        left = page.state == SESSION_INACTIVE ? FOCUS_DURATION
+                                              : remaining_seconds(page.deadline_ns, system_monotonic_ns());
+    }
     
-    if (input_mode) {
-        mvwprintw(input_win, 1, 1, "Add task: %s", input_buffer);
-    } else {
-        mvwprintw(input_win, 1, 1, "Enter: add task | Space: set focus | ?: help");
+    char out[MAX_INPUT_LEN + MAX_TASK_LEN];
+    int len = 0;
+    for (const char *f = format; *f && len < (int)sizeof(out) - 1; f++) {
+        int room = sizeof(out) - len;
+        if (*f != '%' || f[1] == '\0') {
+            out[len++] = *f;
+            continue;
+        }
+        
+        f++;
+        int n = 0;
+        switch (*f) {
+            case 'p': n = snprintf(out + len, room, "%s", phase); break;
+            case 'r':
+                n = left < 0 ? snprintf(out + len, room, "--:--")
+                             : snprintf(out + len, room, "%02d:%02d", left / 60, left % 60);
+                break;
+            case 's': n = snprintf(out + len, room, "%d", left < 0 ? 0 : left); break;
+            case 't': n = snprintf(out + len, room, "%d", found ? page.today_sessions : 0); break;
+            case 'k': n = snprintf(out + len, room, "%d", found ? page.streak : 0); break;
+            case 'f': n = snprintf(out + len, room, "%s", found ? page.focus_task : ""); break;
+            case 'n': n = snprintf(out + len, room, "\n"); break;
+            case '%': n = snprintf(out + len, room, "%%"); break;
+            default: n = snprintf(out + len, room, "%%%c", *f); break;
+        }
+        len += n < room ? n : room - 1;
     }
+    out[len++] = '\n';
     
-    wrefresh(input_win);
+    // One write(), and nothing buffered left to flush at exit
+    return write(STDOUT_FILENO, out, len) == len ? 0 : 1;
 }
 
-int main() {
-    // Set up signal handlers for clean exit
-    struct sigaction sa;
-    sa.sa_handler = signal_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
-    
-    if (sigaction(SIGINT, &sa, NULL) == -1) {
-        perror("sigaction");
-        exit(1);
+void parse_arguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frame-stats") == 0) {
+            frame_stats_on_exit = 1;
+        } else if (strncmp(argv[i], "--latency-dump=", 15) == 0 && argv[i][15] != '\0') {
+            latency_dump_file = argv[i] + 15;
+        } else if (strcmp(argv[i], "--low-bandwidth") == 0) {
+            low_bandwidth = 1;
+        } else if (strcmp(argv[i], "--render-stats") == 0) {
+            render_stats_on_exit = 1;
+        } else if (strncmp(argv[i], "--data-dir=", 11) == 0 && argv[i][11] != '\0') {
+            data_dir = argv[i] + 11;
+        } else if (strncmp(argv[i], "--simulate=", 11) == 0 && argv[i][11] != '\0') {
+            simulate_script = argv[i] + 11;
+        } else if (strcmp(argv[i], "--status") == 0) {
+            status_query = 1;
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            status_format = argv[i] + 9;
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon_mode = 1;
+        } else if (strcmp(argv[i], "--stop-daemon") == 0) {
+            daemon_mode = -1;
+        } else if (strcmp(argv[i], "--server") == 0) {
+            server_mode = 1;
+        } else if (strncmp(argv[i], "--workers=", 10) == 0 && atoi(argv[i] + 10) > 0) {
+            server_workers = atoi(argv[i] + 10);
+        } else if (strcmp(argv[i], "--bench-drift") == 0) {
+            bench_timer_drift();
+            exit(0);
+        } else if (strcmp(argv[i], "--bench-wheel") == 0) {
+            bench_timer_wheel();
+            exit(0);
+        } else if (strcmp(argv[i], "--bench-status") == 0) {
+            bench_status_page();
+            exit(0);
+        } else if (strncmp(argv[i], "--metrics-port=", 15) == 0 && atoi(argv[i] + 15) > 0 && atoi(argv[i] + 15) < 65536) {
+            metrics_port = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--metrics-file=", 15) == 0 && argv[i][15] != '\0') {
+            metrics_file = argv[i] + 15;
+        } else if (strncmp(argv[i], "--stress=", 9) == 0 && atoi(argv[i] + 9) > 0) {
+            stress_instances = atoi(argv[i] + 9);
+        } else if (strcmp(argv[i], "--bench-server") == 0) {
+            server_mode = -1;
+        } else if (strcmp(argv[i], "--version") == 0) {
+            printf("focusforge %s\n", FOCUSFORGE_VERSION);
+            exit(0);
+        } else {
+            fprintf(stderr, "Usage: %s [--low-bandwidth] [--render-stats] [--frame-stats]\n"
+                            "       [--latency-dump=FILE] [--data-dir=DIR] [--simulate=SCRIPT]\n"
+                            "       [--daemon] [--stop-daemon] [--status [--format=FORMAT]]\n"
+                            "       [--metrics-port=PORT] [--metrics-file=PATH]\n"
+                            "       [--server [--workers=N]] [--bench-drift] [--bench-wheel]\n"
+                            "       [--bench-status] [--bench-server] [--stress=N] [--version]\n",
+                    argv[0]);
+            exit(strcmp(argv[i], "--help") == 0 ? 0 : 1);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    parse_arguments(argc, argv);
+    if (status_query) {
+        return run_status_query(status_format);
+    }
+    if (simulate_script) {
+        run_simulation(simulate_script);
+    }
+    if (stress_instances > 0) {
+        run_stress(stress_instances);
+    }
+    if (server_mode == -1) {
+        // After parsing, so --workers= applies to the server it starts
+        bench_server();
+        exit(0);
     }
     
-    if (sigaction(SIGTERM, &sa, NULL) == -1) {
-        perror("sigaction");
+    // SIGINT, SIGTERM, SIGHUP and SIGWINCH are read from signalfd by the event loop
+    sigset_t handled;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGTERM);
+    sigaddset(&handled, SIGHUP);  // Terminal closed: exit cleanly and keep the checkpoint
+    sigaddset(&handled, SIGWINCH);
+    if (sigprocmask(SIG_BLOCK, &handled, NULL) == -1) {
+        perror("sigprocmask");
         exit(1);
     }
     
-    // Set up resize handler
-    struct sigaction resize_sa;
-    resize_sa.sa_handler = resize_handler;
-    sigemptyset(&resize_sa.sa_mask);
-    resize_sa.sa_flags = SA_RESTART;
-    
-    if (sigaction(SIGWINCH, &resize_sa, NULL) == -1) {
-        perror("sigaction");
-        exit(1);
+    // The server keeps its users apart from this user's own data
+    if (server_mode == 1) {
+        run_server(&handled);
     }
     
     // Initialize directories and files
@@ -1641,8 +7084,46 @@ int main() {
     // Load settings
     load_settings();
     
-    // Load existing tasks
-    load_tasks();
+    if (daemon_mode == 1) {
+        run_daemon(&handled);
+    } else if (daemon_mode == -1) {
+        int fd = daemon_connect();
+        if (fd == -1 || send(fd, "shutdown\n", 9, MSG_NOSIGNAL) != 9) {
+            fprintf(stderr, "No FocusForge daemon is running on %s\n", socket_file);
+            exit(1);
+        }
+        
+        // The daemon closes the socket as it exits
+        shutdown(fd, SHUT_WR);
+        char discard[4096];
+        while (recv(fd, discard, sizeof(discard), 0) > 0) {
+        }
+        exit(0);
+    }
+    
+    // With a daemon running, the state is the daemon's and this is only its display
+    daemon_fd = daemon_connect();
+    if (daemon_fd == -1) {
+        // Rebuild tasks, focus and streak from the snapshot and event log
+        state_load();
+    }
+    
+    // All timed events run from one wheel driven by the event loop's timerfd
+    timers_init(monotonic_ns());
+    
+    if (daemon_fd == -1) {
+        // Pick up a session the last run left unfinished
+        offer_resume();
+        
+        // Seal days that ended while FocusForge was closed, then wait for midnight
+        day_rollover();
+        
+        // Status bars read the live state from a shared page from here on
+        status_open();
+    }
+    
+    // Per-thread write counter used to measure bytes sent per frame
+    thread_io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
     
     // Initialize ncurses
     if (initscr() == NULL) {
@@ -1654,6 +7135,8 @@ int main() {
     noecho();
     keypad(stdscr, TRUE);
     curs_set(0);  // Hide cursor for cleaner interface
+    detect_low_bandwidth();
+    render_start_ns = monotonic_ns();
     
     // Check terminal size
     int height, width;
@@ -1667,6 +7150,18 @@ int main() {
     // Setup windows
     setup_windows();
     
+    // Keys are read when epoll reports stdin readable, never by blocking
+    nodelay(stdscr, TRUE);
+    event_loop_init(&handled);
+    if (daemon_fd == -1) {
+        data_watch_start();
+    }
+    if (daemon_fd != -1 && event_add(daemon_fd, EPOLLIN, on_daemon_ready, NULL) == NULL) {
+        endwin();
+        perror("epoll_ctl");
+        exit(1);
+    }
+    
     // Clear screen and display initial screen
     clear();
     refresh();